@@ -0,0 +1,291 @@
+#include "DistanceTable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+using namespace model;
+using namespace std;
+
+const int cache_line = 64;
+
+FreeCells::FreeCells(): size_x(0), size_y(0), size(0) {}
+
+void FreeCells::assign_ids(const vector< vector< CellType > >& cells) {
+    size_x = cells.size();
+    size_y = size_x > 0 ? cells[0].size() : 0;
+    size = 0;
+    ids.assign(size_x * size_y, -1);
+    for (int x = 0; x < size_x; x += 1) {
+        for (int y = 0; y < size_y; y += 1) {
+            if (cells[x][y] == FREE) {
+                ids[x * size_y + y] = size;
+                size += 1;
+            }
+        }
+    }
+
+    const int dx[] = {-1, 0, 1, 0};
+    const int dy[] = {0, -1, 0, 1};
+    neighs.assign(4 * size, -1);
+    for (int x = 0; x < size_x; x += 1) {
+        for (int y = 0; y < size_y; y += 1) {
+            int a = id(x, y);
+            if (a < 0) {
+                continue;
+            }
+            int count = 0;
+            for (int d = 0; d < 4; d += 1) {
+                int nx = x + dx[d];
+                int ny = y + dy[d];
+                if (0 <= nx && nx < size_x && 0 <= ny && ny < size_y &&
+                        id(nx, ny) >= 0) {
+                    neighs[4 * a + count] = id(nx, ny);
+                    count += 1;
+                }
+            }
+        }
+    }
+}
+
+// Floyd never initialises the diagonal, so a cell's distance to itself
+// comes out as its shortest cycle: 2 with a free neighbour, inf without.
+// The BFS rows reproduce that to stay interchangeable with it.
+void FreeCells::bfs(int source, unsigned short* row, vector< int >& queue) const {
+    int head = 0;
+    int tail = 0;
+    row[source] = 0;
+    queue[tail++] = source;
+    while (head < tail) {
+        int a = queue[head++];
+        unsigned short next = row[a] + 1;
+        for (int d = 0; d < 4; d += 1) {
+            int b = neighs[4 * a + d];
+            if (b < 0) {
+                break;
+            }
+            if (row[b] == 0xFFFF) {
+                row[b] = next;
+                queue[tail++] = b;
+            }
+        }
+    }
+    row[source] = neighs[4 * source] >= 0 ? 2 : 0xFFFF;
+}
+
+DistanceTable::DistanceTable(): stride(0), wide(true), data(NULL) {}
+
+int DistanceTable::row_stride(int size, bool wide) {
+    int entry = wide ? 2 : 1;
+    return (size * entry + cache_line - 1) / cache_line * cache_line / entry;
+}
+
+unsigned char* DistanceTable::allocate(bool wide) {
+    this->wide = wide;
+    stride = row_stride(size, wide);
+    int row_bytes = stride * (wide ? 2 : 1);
+
+    vector< unsigned char >().swap(storage);
+    storage.resize((size_t) row_bytes * size + cache_line, 0xFF);
+    size_t offset = (cache_line - (size_t) &storage[0] % cache_line) % cache_line;
+    data = &storage[0] + offset;
+    return &storage[0] + offset;
+}
+
+// Switches to 8-bit entries when no finite distance needs more.
+void DistanceTable::narrow() {
+    const unsigned short* from = (const unsigned short*) data;
+    for (int a = 0; a < size; a += 1) {
+        for (int b = 0; b < size; b += 1) {
+            unsigned short d = from[a * stride + b];
+            if (d != 0xFFFF && d >= 0xFF) {
+                return;
+            }
+        }
+    }
+
+    vector< unsigned short > rows(from, from + (size_t) size * stride);
+    int wide_stride = stride;
+    unsigned char* to = allocate(false);
+    for (int a = 0; a < size; a += 1) {
+        for (int b = 0; b < size; b += 1) {
+            unsigned short d = rows[a * wide_stride + b];
+            to[a * stride + b] = d == 0xFFFF ? 0xFF : d;
+        }
+    }
+}
+
+void DistanceTable::build_floyd(const vector< vector< CellType > >& cells) {
+    assign_ids(cells);
+    unsigned short* dist = (unsigned short*) allocate(true);
+
+    for (int a = 0; a < size; a += 1) {
+        for (int d = 0; d < 4 && neighs[4 * a + d] >= 0; d += 1) {
+            dist[a * stride + neighs[4 * a + d]] = 1;
+        }
+    }
+
+    for (int k = 0; k < size; k += 1) {
+        for (int i = 0; i < size; i += 1) {
+            int ik = dist[i * stride + k];
+            if (ik == 0xFFFF) {
+                continue;
+            }
+            unsigned short* row_i = dist + i * stride;
+            const unsigned short* row_k = dist + k * stride;
+            for (int j = 0; j < size; j += 1) {
+                if (row_k[j] == 0xFFFF) {
+                    continue;
+                }
+                row_i[j] = min(row_i[j], (unsigned short) (ik + row_k[j]));
+            }
+        }
+    }
+
+    narrow();
+}
+
+void DistanceTable::build_bfs(const vector< vector< CellType > >& cells, int threads) {
+    assign_ids(cells);
+    unsigned short* dist = (unsigned short*) allocate(true);
+
+    if (threads <= 0) {
+        threads = max(1, (int) thread::hardware_concurrency());
+    }
+    const int chunk = 16;
+    threads = max(1, min(threads, (size + chunk - 1) / chunk));
+
+    atomic< int > next(0);
+    auto worker = [this, dist, &next, chunk]() {
+        vector< int > queue(size);
+        for (;;) {
+            int from = next.fetch_add(chunk);
+            if (from >= size) {
+                return;
+            }
+            for (int source = from; source < min(size, from + chunk); source += 1) {
+                bfs(source, dist + source * stride, queue);
+            }
+        }
+    };
+
+    // Where no thread can start, e.g. in a static binary linked without
+    // -pthread, the calling thread takes the rows the pool would have.
+    vector< thread > pool;
+    for (int i = 1; i < threads; i += 1) {
+        try {
+            pool.push_back(thread(worker));
+        }
+        catch (const system_error&) {
+            break;
+        }
+    }
+    worker();
+    for (auto& t : pool) {
+        t.join();
+    }
+
+    narrow();
+}
+
+void DistanceTable::attach(const vector< vector< CellType > >& cells,
+        const unsigned char* rows, int stride, bool wide) {
+    assign_ids(cells);
+    vector< unsigned char >().swap(storage);
+    this->stride = stride;
+    this->wide = wide;
+    data = rows;
+}
+
+bool DistanceTable::operator==(const DistanceTable& other) const {
+    if (ids != other.ids) {
+        return false;
+    }
+    for (int a = 0; a < size; a += 1) {
+        for (int b = 0; b < size; b += 1) {
+            if (get(a, b) != other.get(a, b)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+LazyDistances::LazyDistances():
+    capacity(0), used(0), hits(0), misses(0), head(-1), tail(-1) {}
+
+void LazyDistances::init(const vector< vector< CellType > >& cells, int capacity) {
+    assign_ids(cells);
+    this->capacity = max(1, min(capacity, size));
+    used = 0;
+    hits = 0;
+    misses = 0;
+    rows.assign((size_t) this->capacity * size, 0xFFFF);
+    slot_of.assign(size, -1);
+    source_of.assign(this->capacity, -1);
+    prev.assign(this->capacity, -1);
+    next.assign(this->capacity, -1);
+    head = -1;
+    tail = -1;
+    queue.resize(size);
+}
+
+void LazyDistances::unlink(int slot) {
+    if (prev[slot] >= 0) {
+        next[prev[slot]] = next[slot];
+    }
+    else {
+        head = next[slot];
+    }
+    if (next[slot] >= 0) {
+        prev[next[slot]] = prev[slot];
+    }
+    else {
+        tail = prev[slot];
+    }
+}
+
+void LazyDistances::push_front(int slot) {
+    prev[slot] = -1;
+    next[slot] = head;
+    if (head >= 0) {
+        prev[head] = slot;
+    }
+    head = slot;
+    if (tail < 0) {
+        tail = slot;
+    }
+}
+
+const unsigned short* LazyDistances::row(int source) {
+    int slot = slot_of[source];
+    if (slot >= 0) {
+        hits += 1;
+        if (slot != head) {
+            unlink(slot);
+            push_front(slot);
+        }
+        return &rows[(size_t) slot * size];
+    }
+
+    misses += 1;
+    if (used < capacity) {
+        slot = used;
+        used += 1;
+    }
+    else {
+        slot = tail;
+        unlink(slot);
+        slot_of[source_of[slot]] = -1;
+    }
+    source_of[slot] = source;
+    slot_of[source] = slot;
+    push_front(slot);
+
+    unsigned short* result = &rows[(size_t) slot * size];
+    fill(result, result + size, 0xFFFF);
+    bfs(source, result, queue);
+    return result;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#ifndef _DISTANCE_TABLE_H_
+#define _DISTANCE_TABLE_H_
+
+#include <vector>
+
+#include "model/World.h"
+
+// Free cells of the map with dense ids and a 4-neighbour adjacency array.
+struct FreeCells {
+    int size_x;
+    int size_y;
+    int size;          // number of free cells
+    std::vector< int > ids;     // x * size_y + y -> dense id or -1
+    std::vector< int > neighs;  // 4 dense ids per cell, -1 padded
+
+    FreeCells();
+
+    int id(int x, int y) const {
+        return ids[x * size_y + y];
+    }
+
+    void assign_ids(const std::vector< std::vector< model::CellType > >& cells);
+
+    // Fills a row of 0xFFFF with distances from source.
+    void bfs(int source, unsigned short* row, std::vector< int >& queue) const;
+};
+
+// All-pairs shortest path lengths between free cells.
+//
+// The table is one contiguous buffer of size * size entries, every row
+// starting on a cache line.  Entries are 8-bit when all finite distances
+// fit, 16-bit otherwise.
+struct DistanceTable : FreeCells {
+    static const int inf = 1e9;
+
+    int stride;        // entries per row, padded to a cache line
+    bool wide;         // 16-bit entries
+    std::vector< unsigned char > storage;
+    const unsigned char* data;  // aligned start of storage or mapped rows
+
+    DistanceTable();
+
+    int get(int a, int b) const {
+        if (wide) {
+            unsigned short d = ((const unsigned short*) data)[a * stride + b];
+            return d == 0xFFFF ? inf : d;
+        }
+        unsigned char d = data[a * stride + b];
+        return d == 0xFF ? inf : d;
+    }
+
+    int get(int ax, int ay, int bx, int by) const {
+        int a = id(ax, ay);
+        int b = id(bx, by);
+        if (a < 0 || b < 0) {
+            return inf;
+        }
+        return get(a, b);
+    }
+
+    // O(V^3), kept as the reference the BFS engine is checked against.
+    void build_floyd(const std::vector< std::vector< model::CellType > >& cells);
+
+    // One BFS per source over the adjacency array, O(V^2).  Rows are
+    // split between threads (0: one per hardware thread) and each row is
+    // written by exactly one of them, so the result does not depend on
+    // the thread count.
+    void build_bfs(const std::vector< std::vector< model::CellType > >& cells,
+            int threads = 1);
+
+    // Uses rows stored elsewhere, e.g. mapped from the map cache.
+    void attach(const std::vector< std::vector< model::CellType > >& cells,
+            const unsigned char* rows, int stride, bool wide);
+
+    size_t bytes() const {
+        return (size_t) size * stride * (wide ? 2 : 1);
+    }
+
+    // Entries per row of a table over size cells.
+    static int row_stride(int size, bool wide);
+
+    bool operator==(const DistanceTable& other) const;
+
+private:
+    unsigned char* allocate(bool wide);
+    void narrow();
+};
+
+// The same distances computed on demand: a BFS row is built the first
+// time its source is queried and kept in an LRU cache of capacity rows.
+// Memory stays linear in the map size.
+struct LazyDistances : FreeCells {
+    static const int inf = 1e9;
+
+    int capacity;
+    int used;
+    long long hits;
+    long long misses;
+    std::vector< unsigned short > rows;    // capacity rows of size entries
+    std::vector< int > slot_of;            // source -> slot or -1
+    std::vector< int > source_of;          // slot -> source
+    std::vector< int > prev;               // LRU list over slots
+    std::vector< int > next;
+    int head;                              // most recently used slot
+    int tail;                              // least recently used slot
+    std::vector< int > queue;
+
+    LazyDistances();
+
+    void init(const std::vector< std::vector< model::CellType > >& cells, int capacity);
+
+    const unsigned short* row(int source);
+
+    // Rows are keyed by the second point: callers pass the end that stays
+    // put between queries (a trooper, the target) there.
+    int get(int ax, int ay, int bx, int by) {
+        int a = id(ax, ay);
+        int b = id(bx, by);
+        if (a < 0 || b < 0) {
+            return inf;
+        }
+        unsigned short d = row(b)[a];
+        return d == 0xFFFF ? inf : d;
+    }
+
+private:
+    void unlink(int slot);
+    void push_front(int slot);
+};
+
+#endif
@@ -0,0 +1,62 @@
+#include "DominanceIndex.h"
+
+#include "Telemetry.h"
+
+using namespace std;
+
+DominanceIndex::DominanceIndex():
+    mask(0),
+    generation(0) {}
+
+void DominanceIndex::init(int bits) {
+    Slot empty;
+    empty.group = -1;
+    empty.generation = 0;
+    empty.count = 0;
+    slots.assign(1U << bits, empty);
+    mask = (1U << bits) - 1;
+    generation = 1;
+}
+
+void DominanceIndex::reset() {
+    generation += 1;
+}
+
+bool DominanceIndex::dominated(int group, const Entry& entry) {
+    // Neighbouring cells share the low bits, so these are mixed in.
+    Slot& slot = slots[(group ^ (group >> 11) ^ (group >> 19)) & mask];
+    if (slot.generation != generation || slot.group != group) {
+        slot.group = group;
+        slot.generation = generation;
+        slot.count = 0;
+    }
+
+    for (int i = 0; i < slot.count; i += 1) {
+        if (slot.frontier[i].dominates(entry)) {
+            telemetry.dominated += 1;
+            return true;
+        }
+    }
+
+    // Drops what the new state dominates, then makes room for it.
+    int kept = 0;
+    int fewest = 0;
+    for (int i = 0; i < slot.count; i += 1) {
+        if (!entry.dominates(slot.frontier[i])) {
+            slot.frontier[kept] = slot.frontier[i];
+            if (slot.frontier[kept].action_points < slot.frontier[fewest].action_points) {
+                fewest = kept;
+            }
+            kept += 1;
+        }
+    }
+    if (kept < WIDTH) {
+        slot.frontier[kept] = entry;
+        kept += 1;
+    }
+    else {
+        slot.frontier[fewest] = entry;
+    }
+    slot.count = kept;
+    return false;
+}
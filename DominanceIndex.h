@@ -0,0 +1,66 @@
+#pragma once
+
+#ifndef _DOMINANCE_INDEX_H_
+#define _DOMINANCE_INDEX_H_
+
+#include <vector>
+
+// Search states already expanded during the current iteration, grouped by
+// (cell, stance, item flags).  A state is dominated by another one of its
+// group that had at least as many action points and actions left, no less
+// damage and kills, no more mate damage and no later place in the
+// canonical action order: whatever line follows it scores at most what
+// the same line scored after the other one.
+//
+// The index has a fixed number of slots, each holding the frontier of one
+// group: a few states none of which dominates another.  When a frontier is
+// full the newest state replaces the one with the fewest action points,
+// and a group that maps to a taken slot evicts its frontier.  Slots of
+// earlier iterations are told apart by a generation number, so reset()
+// does not touch the index.
+struct DominanceIndex {
+    static const int WIDTH = 4;     // states per frontier
+
+    struct Entry {
+        int action_points;
+        int depth;              // actions left below the state
+        int damage;
+        int kills;
+        int mate_damage;
+        int order;              // lowest action rank that may follow
+
+        bool dominates(const Entry& other) const {
+            return action_points >= other.action_points && depth >= other.depth &&
+                damage >= other.damage && kills >= other.kills &&
+                mate_damage <= other.mate_damage && order <= other.order;
+        }
+    };
+
+    struct Slot {
+        int group;
+        unsigned generation;
+        int count;
+        Entry frontier[WIDTH];
+    };
+
+    std::vector< Slot > slots;
+    unsigned mask;              // slots - 1
+    unsigned generation;
+
+    DominanceIndex();
+
+    bool enabled() const {
+        return !slots.empty();
+    }
+
+    // 2^bits slots.
+    void init(int bits);
+
+    void reset();
+
+    // True when an expanded state of the group dominates the given one.
+    // Otherwise adds it to the group's frontier and returns false.
+    bool dominated(int group, const Entry& entry);
+};
+
+#endif
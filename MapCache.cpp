@@ -0,0 +1,200 @@
+#include "MapCache.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _LINUX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace model;
+using namespace std;
+
+const char magic[8] = {'S', 'L', 'A', 'V', 'A', 'M', 'A', 'P'};
+const size_t section_align = 64;
+
+size_t align_up(size_t offset) {
+    return (offset + section_align - 1) / section_align * section_align;
+}
+
+// Whether bytes at offset lie in a file of file_bytes, without overflow.
+bool in_file(unsigned long long offset, unsigned long long bytes, size_t file_bytes) {
+    return offset <= file_bytes && bytes <= file_bytes - offset;
+}
+
+MapCache::MapCache(): mapped(NULL), mapped_bytes(0) {}
+
+MapCache::~MapCache() {
+    close();
+}
+
+unsigned long long MapCache::hash(const vector< vector< CellType > >& cells) {
+    unsigned long long h = 14695981039346656037ULL;   // FNV-1a
+    int size_x = cells.size();
+    int size_y = size_x > 0 ? cells[0].size() : 0;
+    h = (h ^ size_x) * 1099511628211ULL;
+    h = (h ^ size_y) * 1099511628211ULL;
+    for (int x = 0; x < size_x; x += 1) {
+        for (int y = 0; y < size_y; y += 1) {
+            h = (h ^ (unsigned char) cells[x][y]) * 1099511628211ULL;
+        }
+    }
+    return h;
+}
+
+string MapCache::path(const string& dir, unsigned long long hash) {
+    char name[32];
+    snprintf(name, sizeof name, "%016llx.map", hash);
+    return dir + "/" + name;
+}
+
+#ifdef _LINUX
+
+void MapCache::close() {
+    if (mapped != NULL) {
+        munmap((void*) mapped, mapped_bytes);
+        mapped = NULL;
+        mapped_bytes = 0;
+    }
+}
+
+bool MapCache::open(const string& dir, const vector< vector< CellType > >& cells) {
+    close();
+    unsigned long long h = hash(cells);
+    int fd = ::open(path(dir, h).c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+    void* address = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    mapped = (const unsigned char*) address;
+    mapped_bytes = st.st_size;
+
+    // Every section must have exactly the size the tables expect for
+    // these cells, so a stale or damaged file is never read past its end.
+    const Header& head = header();
+    int size_x = cells.size();
+    int size_y = size_x > 0 ? cells[0].size() : 0;
+    FreeCells free_cells;
+    free_cells.assign_ids(cells);
+    bool wide = head.distance_wide != 0;
+    size_t distance_bytes = (size_t) free_cells.size
+        * DistanceTable::row_stride(free_cells.size, wide) * (wide ? 2 : 1);
+    size_t visibility_bytes = (size_t) VisibilityMatrix::getWordCount(
+            size_x, size_y, _TROOPER_STANCE_COUNT_) * sizeof(unsigned long long);
+    bool valid = memcmp(head.magic, magic, sizeof magic) == 0
+        && head.version == version
+        && head.hash == h
+        && head.size_x == (unsigned int) size_x
+        && head.size_y == (unsigned int) size_y
+        && head.distance_wide <= 1
+        && head.distance_stride == (unsigned int) DistanceTable::row_stride(free_cells.size, wide)
+        && head.distance_bytes == distance_bytes
+        && (head.visibility_bytes == 0 || head.visibility_bytes == visibility_bytes)
+        && head.distance_offset % section_align == 0
+        && head.visibility_offset % section_align == 0
+        && in_file(head.cells_offset, (size_t) size_x * size_y, mapped_bytes)
+        && in_file(head.distance_offset, head.distance_bytes, mapped_bytes)
+        && in_file(head.visibility_offset, head.visibility_bytes, mapped_bytes);
+    for (int x = 0; valid && x < size_x; x += 1) {
+        for (int y = 0; valid && y < size_y; y += 1) {
+            valid = (signed char) mapped[head.cells_offset + x * size_y + y] == cells[x][y];
+        }
+    }
+    if (!valid) {
+        close();
+    }
+    return valid;
+}
+
+bool write_all(int fd, const void* bytes, size_t count) {
+    const char* from = (const char*) bytes;
+    while (count > 0) {
+        ssize_t written = write(fd, from, count);
+        if (written <= 0) {
+            return false;
+        }
+        from += written;
+        count -= written;
+    }
+    return true;
+}
+
+bool MapCache::save(const string& dir, const vector< vector< CellType > >& cells,
+        const DistanceTable& distances, const VisibilityMatrix& visibilities) {
+    int size_x = cells.size();
+    int size_y = size_x > 0 ? cells[0].size() : 0;
+
+    Header head;
+    memset(&head, 0, sizeof head);
+    memcpy(head.magic, magic, sizeof magic);
+    head.version = version;
+    head.size_x = size_x;
+    head.size_y = size_y;
+    head.distance_stride = distances.stride;
+    head.distance_wide = distances.wide;
+    head.hash = hash(cells);
+    head.cells_offset = sizeof head;
+    head.distance_offset = align_up(head.cells_offset + (size_t) size_x * size_y);
+    head.distance_bytes = distances.bytes();
+    head.visibility_offset = align_up(head.distance_offset + head.distance_bytes);
+    head.visibility_bytes = (size_t) visibilities.getWordCount() * sizeof(unsigned long long);
+
+    vector< unsigned char > file(head.visibility_offset + head.visibility_bytes, 0);
+    memcpy(&file[0], &head, sizeof head);
+    for (int x = 0; x < size_x; x += 1) {
+        for (int y = 0; y < size_y; y += 1) {
+            file[head.cells_offset + x * size_y + y] = (unsigned char) cells[x][y];
+        }
+    }
+    if (head.distance_bytes > 0) {
+        memcpy(&file[head.distance_offset], distances.data, head.distance_bytes);
+    }
+    if (head.visibility_bytes > 0) {
+        memcpy(&file[head.visibility_offset], visibilities.getWords(), head.visibility_bytes);
+    }
+
+    // Written aside and renamed, so a concurrent reader never maps half a file.
+    mkdir(dir.c_str(), 0755);
+    string final_path = path(dir, head.hash);
+    char temp_suffix[32];
+    snprintf(temp_suffix, sizeof temp_suffix, ".%d", (int) getpid());
+    string temp_path = final_path + temp_suffix;
+    int fd = ::open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = write_all(fd, &file[0], file.size());
+    ok = ::close(fd) == 0 && ok;
+    if (!ok || rename(temp_path.c_str(), final_path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+#else
+
+void MapCache::close() {}
+
+bool MapCache::open(const string&, const vector< vector< CellType > >&) {
+    return false;
+}
+
+bool MapCache::save(const string&, const vector< vector< CellType > >&,
+        const DistanceTable&, const VisibilityMatrix&) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef _MAP_CACHE_H_
+#define _MAP_CACHE_H_
+
+#include <string>
+#include <vector>
+
+#include "DistanceTable.h"
+#include "model/World.h"
+
+// Per-map precomputations kept on disk between launches.
+//
+// <dir>/<hash of the cells>.map holds a header, the cell grid, the
+// distance table rows exactly as DistanceTable keeps them and the
+// visibility rows exactly as model::VisibilityMatrix keeps them, if any.  A
+// valid file is mapped read-only and used in place, and one mapping is
+// shared by the protocol client and the strategy.
+struct MapCache {
+    static const unsigned int version = 2;
+
+    struct Header {
+        char magic[8];
+        unsigned int version;
+        unsigned int size_x;
+        unsigned int size_y;
+        unsigned int distance_stride;
+        unsigned int distance_wide;
+        unsigned int reserved;
+        unsigned long long hash;
+        unsigned long long cells_offset;
+        unsigned long long distance_offset;
+        unsigned long long distance_bytes;
+        unsigned long long visibility_offset;
+        unsigned long long visibility_bytes;
+    };
+
+    const unsigned char* mapped;
+    size_t mapped_bytes;
+
+    MapCache();
+    ~MapCache();
+
+    static unsigned long long hash(const std::vector< std::vector< model::CellType > >& cells);
+
+    // Maps the cache file for cells, false when there is no valid one.
+    bool open(const std::string& dir, const std::vector< std::vector< model::CellType > >& cells);
+
+    const Header& header() const {
+        return *(const Header*) mapped;
+    }
+
+    const unsigned char* distance_rows() const {
+        return mapped + header().distance_offset;
+    }
+
+    const unsigned long long* visibility_words() const {
+        return (const unsigned long long*) (mapped + header().visibility_offset);
+    }
+
+    static bool save(const std::string& dir,
+            const std::vector< std::vector< model::CellType > >& cells,
+            const DistanceTable& distances,
+            const model::VisibilityMatrix& visibilities);
+
+    static std::string path(const std::string& dir, unsigned long long hash);
+
+private:
+    void close();
+};
+
+#endif
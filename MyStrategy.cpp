@@ -1,10 +1,24 @@
 #include "MyStrategy.h"
 
+#include "DistanceTable.h"
+#include "DominanceIndex.h"
+#include "MapCache.h"
+#include "Settings.h"
+#include "Telemetry.h"
+#include "TimeBudget.h"
+#include "TranspositionTable.h"
+
 #include <iostream>
+#include <sstream>
 #include <vector>
 #include <set>
 #include <cmath>
 #include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <system_error>
+#include <unordered_map>
 
 using namespace model;
 using namespace std;
@@ -63,6 +77,8 @@ ostream& operator<<(ostream& out, const TrooperStance& stance) {
     };
 }
 
+struct Neighs;
+
 struct Point {
     int x, y;
 
@@ -78,14 +94,7 @@ struct Point {
         return p.isCorrect() && abs(x - p.x) + abs(y - p.y) == 1;
     }
 
-    vector< Point > neighs() const {
-        vector< Point > result;
-        if (x - 1 >= 0)    { result.push_back(Point(x - 1, y)); }
-        if (y - 1 >= 0)    { result.push_back(Point(x, y - 1)); }
-        if (x + 1 < sizeX) { result.push_back(Point(x + 1, y)); }
-        if (y + 1 < sizeY) { result.push_back(Point(x, y + 1)); }
-        return result;
-    }
+    Neighs neighs() const;
 
     double distance_to(const Point& p) const {
         int xRange = p.x - x;
@@ -110,6 +119,31 @@ struct Point {
     }
 };
 
+// Up to four points in place, as neighs() is called for every search node.
+struct Neighs {
+    Point points[4];
+    int count;
+
+    Neighs(): count(0) {}
+
+    void push_back(const Point& p) {
+        points[count] = p;
+        count += 1;
+    }
+
+    const Point* begin() const { return points; }
+    const Point* end() const { return points + count; }
+};
+
+Neighs Point::neighs() const {
+    Neighs result;
+    if (x - 1 >= 0)    { result.push_back(Point(x - 1, y)); }
+    if (y - 1 >= 0)    { result.push_back(Point(x, y - 1)); }
+    if (x + 1 < sizeX) { result.push_back(Point(x + 1, y)); }
+    if (y + 1 < sizeY) { result.push_back(Point(x, y + 1)); }
+    return result;
+}
+
 int random(int bound) { // [0, bound)
     return rand() % bound;
 }
@@ -134,22 +168,328 @@ Action make_action(ActionType action, const Point& p) {
 
 Point target;
 int move_index = -1;
-vector< vector< vector< vector< int > > > > floyd_dist;
+DistanceTable distances;
+LazyDistances lazy_distances;
+bool lazy = false;
+MapCache map_cache;
+TranspositionTable transpositions;
+DominanceIndex dominance;
+TimeBudget time_budget;
+
+// Kept from move to move, so that a move allocates nothing once they have
+// grown.
+vector< char > occupied;    // per cell, a trooper stands there
+vector< Trooper > teammates;
+vector< Trooper > enemies;
+vector< TrooperStance > stances;
+vector< TrooperStance > enemy_stances;  // those an enemy is looked for in
+
+// Fills the distances for the map: lazy rows for large maps, else the
+// cached table or a fresh one.  The cache is the one shared mapped, else
+// map_cache opened here.  Returns whether the table was built here and so
+// is worth saving.
+bool prepare_distances(const Cells& cells, const MapCache* shared = NULL) {
+    FreeCells free_cells;
+    free_cells.assign_ids(cells);
+    if (free_cells.size > settings.distance_table_max_cells) {
+        lazy = true;
+        lazy_distances.init(cells, settings.distance_cache_rows);
+        log_("lazy distances for " << free_cells.size << " cells");
+        return false;
+    }
+
+    const MapCache* cache = shared;
+    if (cache == NULL && !settings.cache_dir.empty() && map_cache.open(settings.cache_dir, cells)) {
+        cache = &map_cache;
+    }
+    if (cache != NULL && cache->mapped != NULL) {
+        const MapCache::Header& header = cache->header();
+        distances.attach(cells, cache->distance_rows(),
+                header.distance_stride, header.distance_wide);
+        log_("distances mapped from cache");
+        return false;
+    }
+
+    distances.build_bfs(cells, settings.distance_threads);
+    return true;
+}
+
+// prepare_distances() run on its own thread while the runner is still
+// sending the visibilities of the first context.  Where no thread can
+// start, e.g. in a static binary linked without -pthread, it runs right
+// away instead.
+struct DistanceWorker {
+    typedef chrono::steady_clock Clock;
+
+    thread worker;
+    bool started;
+    bool built;
+    Clock::time_point start;
+    Clock::time_point end;
+
+    DistanceWorker(): started(false), built(false) {}
+
+    void run(const Cells& cells, const MapCache& cache) {
+        start = Clock::now();
+        built = prepare_distances(cells, &cache);
+        end = Clock::now();
+    }
+
+    ~DistanceWorker() {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+};
+
+DistanceWorker distance_worker;
 
 int min_distance(const Point& a, const Point& b) {
-    return floyd_dist[a.x][a.y][b.x][b.y];
+    if (lazy) {
+        return lazy_distances.get(a.x, a.y, b.x, b.y);
+    }
+    return distances.get(a.x, a.y, b.x, b.y);
 }
 
+// For every (cell, stance) the enemies that can hit a trooper standing
+// there: in grenade range, or in shooting range and visible from one of
+// the given enemy stances.
+struct ThreatMap {
+    vector< int > counts;
+    vector< int > damage;   // what those enemies deal in a turn of shooting
+    vector< unsigned long long > seen;
+
+    int index(const Point& p, TrooperStance stance) const {
+        return (p.x * sizeY + p.y) * _TROOPER_STANCE_COUNT_ + stance;
+    }
+
+    int count(const Point& p, TrooperStance stance) const {
+        return counts[index(p, stance)];
+    }
+
+    void build(const World& world, const Game& game, const vector< Trooper >& enemies,
+            const vector< TrooperStance >& enemy_stances) {
+        counts.assign(sizeX * sizeY * _TROOPER_STANCE_COUNT_, 0);
+        damage.assign(counts.size(), 0);
+
+        const VisibilityMatrix& visibility = world.getCellVisibilities();
+        int words = visibility.getRowWords();
+        seen.resize(words);
+
+        for (auto& enemy : enemies) {
+            Point e(enemy);
+            double range = enemy.getShootingRange();
+            int turn_damage = enemy.getDamage() *
+                (enemy.getInitialActionPoints() / enemy.getShootCost());
+
+            for (int stance = 0; stance < _TROOPER_STANCE_COUNT_; stance += 1) {
+                // isVisible() looks at the lower of the two stances.
+                fill(seen.begin(), seen.end(), 0);
+                for (auto& enemy_stance : enemy_stances) {
+                    const unsigned long long* row =
+                        visibility.getRow(e.x, e.y, min((int) enemy_stance, stance));
+                    for (int w = 0; w < words; w += 1) {
+                        seen[w] |= row[w];
+                    }
+                }
+
+                for (int x = 0; x < sizeX; x += 1) {
+                    for (int y = 0; y < sizeY; y += 1) {
+                        Point p(x, y);
+                        int bit = x * sizeY + y;
+                        int xRange = x - e.x;
+                        int yRange = y - e.y;
+                        bool hits = p.distance_to(e) <= game.getGrenadeThrowRange() ||
+                            (xRange * xRange + yRange * yRange <= range * range &&
+                             ((seen[bit >> 6] >> (bit & 63)) & 1));
+                        if (hits) {
+                            counts[index(p, (TrooperStance) stance)] += 1;
+                            damage[index(p, (TrooperStance) stance)] += turn_damage;
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+ThreatMap threats;
+
+// Between two moves only the position is fixed, so the other actions
+// commute but for shots, whose damage depends on the stance, and every
+// order of them reaches the same state.  The search tries them in one
+// order only: eating first, then the medkit, the grenade, heals and shots,
+// each by target, and after a stance change only shots.  A ration can be
+// eaten as soon as it is held, so it is eaten then or never.  Costs only
+// add up, and eating earlier leaves more points for the rest, so the
+// canonical order of a line is as affordable as the line itself.
+struct ActionRanks {
+    int eat;
+    int medkit;             // + the target's index, self last
+    int grenade;            // + the enemy's index
+    int heal;               // + the target's index, self last
+    int shoot;              // + the enemy's index
+    int end;                // below 64 with five troopers a side
+
+    void build(int mates, int enemies) {
+        eat = 0;
+        medkit = eat + 1;
+        grenade = medkit + mates + 1;
+        heal = grenade + enemies;
+        shoot = heal + mates + 1;
+        end = shoot + enemies;
+    }
+};
+
+// Per-move facts for an optimistic bound on the leaf score below a state:
+// every action point spent at the best rate of shooting or healing, the
+// grenade thrown at its best, every item held, and the positional terms
+// as good as the reachable steps allow.
+struct SearchBounds {
+    double gain_per_point;  // shooting or healing, per action point
+    int grenade_gain;
+    int ration_points;      // action points a field ration adds
+    int cheapest_action;
+    int cheapest_move;
+    int threat_floor;       // fewest enemies covering any cell
+    int commander_bonus;
+    bool can_heal;
+    bool medkit_bonus;      // lying on the map
+    bool ration_bonus;
+    bool grenade_bonus;
+
+    void build(const Trooper& self, const World& world, const Game& game) {
+        medkit_bonus = ration_bonus = grenade_bonus = false;
+        for (auto& bonus : world.getBonuses()) {
+            medkit_bonus = medkit_bonus || bonus.getType() == MEDIKIT;
+            ration_bonus = ration_bonus || bonus.getType() == FIELD_RATION;
+            grenade_bonus = grenade_bonus || bonus.getType() == GRENADE;
+        }
+
+        int damage = 0;
+        for (auto& stance : stances) {
+            damage = max(damage, self.getDamage(stance));
+        }
+        bool killable = false;
+        for (auto& enemy : enemies) {
+            killable = killable || damage >= enemy.getHitpoints();
+        }
+        gain_per_point = enemies.empty() ? 0 :
+            (300.0 * damage + 20000 * killable) / self.getShootCost();
+
+        int medikit_heal = self.getMaximalHitpoints() - self.getHitpoints() > 0 ?
+            game.getMedikitHealSelfBonusHitpoints() : 0;
+        int medic_heal = self.getMaximalHitpoints() - self.getHitpoints() > 0 ?
+            game.getFieldMedicHealSelfBonusHitpoints() : 0;
+        for (auto& mate : teammates) {
+            int missing = mate.getMaximalHitpoints() - mate.getHitpoints();
+            medikit_heal = max(medikit_heal, min(game.getMedikitBonusHitpoints(), missing));
+            medic_heal = max(medic_heal, min(game.getFieldMedicHealBonusHitpoints(), missing));
+        }
+        if (!self.isHoldingMedikit() && !medkit_bonus) {
+            medikit_heal = 0;
+        }
+        if (self.getType() != FIELD_MEDIC) {
+            medic_heal = 0;
+        }
+        can_heal = medikit_heal > 0 || medic_heal > 0;
+        gain_per_point = max(gain_per_point, 2000.0 * medikit_heal / game.getMedikitUseCost());
+        gain_per_point = max(gain_per_point, 2000.0 * medic_heal / game.getFieldMedicHealCost());
+
+        int hit = min((int) enemies.size(), 5);
+        grenade_gain = hit == 0 ? 0 :
+            300 * (game.getGrenadeDirectDamage() + (hit - 1) * game.getGrenadeCollateralDamage()) +
+            20000 * hit;
+
+        ration_points = max(0, game.getFieldRationBonusActionPoints() - game.getFieldRationEatCost());
+
+        cheapest_move = min(game.getStandingMoveCost(),
+                min(game.getKneelingMoveCost(), game.getProneMoveCost()));
+        cheapest_action = min(cheapest_move, min(game.getStanceChangeCost(), self.getShootCost()));
+        cheapest_action = min(cheapest_action, min(game.getMedikitUseCost(), game.getGrenadeThrowCost()));
+        cheapest_action = min(cheapest_action, min(game.getFieldMedicHealCost(), game.getFieldRationEatCost()));
+        cheapest_move = max(cheapest_move, 1);
+        cheapest_action = max(cheapest_action, 1);
+
+        threat_floor = 0;
+        if (settings.threat_map && !threats.counts.empty()) {
+            threat_floor = *min_element(threats.counts.begin(), threats.counts.end());
+        }
+
+        commander_bonus = 0;
+        for (auto& mate : teammates) {
+            if (mate.getType() == COMMANDER && self.getType() != SCOUT) {
+                commander_bonus = 500;
+            }
+        }
+    }
+};
+
+// The rest of a trooper's best line, played without searching again as
+// long as the world is what the search saw: the trooper where its own
+// actions took it, in the same turn and after the same target, and every
+// other trooper where it was, with the same hitpoints and stance.  A hit
+// or a heal changes hitpoints, so the line is searched again after one.
+struct PlanCache {
+    long long trooper;      // -1: no plan
+    int world_move;
+    Point target;
+    Point pos;              // where the actions so far take the trooper
+    TrooperStance stance;
+    int action_points;
+    bool has_medkit;
+    bool has_field_ration;
+    bool has_grenade;
+    int score;              // of the whole line when it was searched
+    vector< Trooper > troopers;     // as the search saw them
+    vector< Action > line;
+    size_t next;            // the action to play
+
+    PlanCache(): trooper(-1) {}
+
+    bool matches(const Trooper& self, const World& world) const {
+        if (trooper != self.getId() || world_move != world.getMoveIndex() ||
+                next >= line.size() || target != ::target ||
+                Point(self) != pos || self.getStance() != stance ||
+                self.getActionPoints() != action_points ||
+                self.isHoldingMedikit() != has_medkit ||
+                self.isHoldingFieldRation() != has_field_ration ||
+                self.isHoldingGrenade() != has_grenade ||
+                world.getTroopers().size() != troopers.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < troopers.size(); i += 1) {
+            const Trooper& now = world.getTroopers()[i];
+            const Trooper& then = troopers[i];
+            if (now.getId() != then.getId() || now.getHitpoints() != then.getHitpoints() ||
+                    (now.getId() != trooper &&
+                     (Point(now) != Point(then) || now.getStance() != then.getStance()))) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+PlanCache plans;
+
+// Lines of the search, kept between moves for their memory.
+struct SearchLines {
+    vector< Action > path;      // to the node being searched
+    vector< Action > best;      // to the best node of the iteration
+    vector< Action > result;    // to the one played
+} lines;
+
 struct SlavaStrategy {
 
     const Trooper& self;
     const World& world;
     const Game& game;
 
-    Cells cells;
-    vector< Trooper > teammates;
-    vector< Trooper > enemies;
-    vector< TrooperStance > stances;
+    const Cells& cells;
+    SearchBounds bounds;
+    ActionRanks ranks;
+    double budget;          // seconds of search, 0: no limit
 
     void init() {
 #ifdef SLAVA_DEBUG
@@ -165,20 +505,39 @@ struct SlavaStrategy {
         stances.push_back(KNEELING);
         stances.push_back(STANDING);
 
-        floyd();
+        compute_distances();
+
+        if (settings.transposition_bits > 0) {
+            transpositions.init(sizeX * sizeY, _TROOPER_STANCE_COUNT_, 5,
+                    settings.transposition_bits);
+        }
+        if (settings.dominance_bits > 0) {
+            dominance.init(settings.dominance_bits);
+        }
+        // Lines hold an action per level, and a game has at most four
+        // squads of five.
+        lines.path.reserve(settings.search_depth + 1);
+        lines.best.reserve(settings.search_depth + 1);
+        lines.result.reserve(settings.search_depth + 1);
+        plans.line.reserve(settings.search_depth + 1);
+        plans.troopers.reserve(20);
     }
 
     SlavaStrategy(const Trooper& self, const World& world,
-            const Game& game): self(self), world(world), game(game) {
+            const Game& game): self(self), world(world), game(game),
+            cells(world.getCells()), budget(settings.move_budget) {
 
         move_index += 1;
         if (move_index == 0) {
             init();
         }
 
-        cells = world.getCells();
+        // Troopers block their cells; the map itself is only referenced.
+        occupied.assign(sizeX * sizeY, false);
+        teammates.clear();
+        enemies.clear();
         for (auto& trooper : world.getTroopers()) {
-            cells[trooper.getX()][trooper.getY()] = LOW_COVER;
+            occupied[trooper.getX() * sizeY + trooper.getY()] = true;
             if (trooper.isTeammate()) {
                 teammates.push_back(trooper);
             }
@@ -186,12 +545,39 @@ struct SlavaStrategy {
                 enemies.push_back(trooper);
             }
         }
+
+        ranks.build(teammates.size(), enemies.size());
+
+        // The stances were once only known on the first move, and from then
+        // on only grenade range made a cell dangerous.  The evaluation is
+        // tuned to that.
+        enemy_stances.clear();
+        if (move_index == 0 || settings.visible_threats) {
+            enemy_stances.assign(stances.begin(), stances.end());
+        }
+    }
+
+    // What only the search reads, left alone when a plan is played on.
+    void prepare_search() {
+        if (settings.threat_map) {
+            threats.build(world, game, enemies, enemy_stances);
+        }
+        if (settings.branch_and_bound) {
+            bounds.build(self, world, game);
+        }
     }
 
     Action best_action;
     int best_score;
     Action cur_action;
 
+    typedef chrono::steady_clock Clock;
+
+    int depth;              // actions the current iteration looks ahead
+    bool truncated;         // some line was cut at depth
+    bool aborted;           // ran out of the move budget
+    Clock::time_point deadline;
+
     struct State {
         int mate_damage;
         int damage;
@@ -203,6 +589,7 @@ struct SlavaStrategy {
         bool used_field_ration; // TODO: better method
         bool has_grenade;       // TODO: use grenades
         bool used_grenade;      // TODO: better method
+        int order;              // lowest action rank that may follow
     };
 
     Action run() {
@@ -218,8 +605,13 @@ struct SlavaStrategy {
         int action_points = self.getActionPoints();
         log(self.getType() << " " << self.getStance() << " (" << action_points << ") at " << Point(self));
 
-        best_score = -inf;
-        cur_action = make_action(END_TURN);
+#ifdef SLAVA_DEBUG
+        long long nodes = telemetry.nodes;
+        long long tt_probes = telemetry.tt_probes;
+        long long tt_hits = telemetry.tt_hits;
+        long long pruned = telemetry.pruned;
+        long long dominated = telemetry.dominated;
+#endif
 
         State state;
         state.mate_damage       = 0;
@@ -232,15 +624,364 @@ struct SlavaStrategy {
         state.used_field_ration = false;
         state.has_grenade       = self.isHoldingGrenade();
         state.used_grenade      = false;
+        state.order             = ranks.eat;
 
-        maximize_score(0, action_points, state);
-        log("best_score = " << best_score);
-        return best_action;
+        Action planned;
+        if (settings.plan_cache && replay(state, action_points, planned)) {
+            return planned;
+        }
+        prepare_search();
+
+        // Iterative deepening: every depth starts over and the action of
+        // the last one searched to the end is played.  Without a budget
+        // the shallow iterations would be wasted and only the last runs.
+        // Most lines end on action points well before the full depth, so
+        // neighbouring depths cost nearly the same; the depths step back
+        // from the full one by deepening_step to restart fewer times.
+        Action result = make_action(END_TURN);
+        int result_score = -inf;
+        int completed = 0;
+        aborted = false;
+        deadline = Clock::now() + chrono::duration_cast< Clock::duration >(
+                chrono::duration< double >(budget));
+
+        if (settings.turn_planner) {
+            result = plan(state, action_points, result_score, completed);
+        }
+        else {
+            int step = max(settings.deepening_step, 1);
+            depth = budget > 0 ? (settings.search_depth - 1) % step + 1 : settings.search_depth;
+            for (; depth <= settings.search_depth; depth += step) {
+                best_score = -inf;
+                cur_action = make_action(END_TURN);
+                lines.best.clear();
+                truncated = false;
+                transpositions.reset();
+                dominance.reset();
+
+                maximize_score(0, action_points, state);
+                if (aborted) {
+                    log("depth " << depth << " out of time");
+                    if (result_score == -inf) {
+                        result = best_action;
+                        result_score = best_score;
+                        lines.result = lines.best;
+                    }
+                    break;
+                }
+                result = best_action;
+                result_score = best_score;
+                lines.result = lines.best;
+                completed = depth;
+                if (!truncated) {
+                    break;      // every line ran out of action points
+                }
+            }
+        }
+
+        telemetry.best_score = result_score;
+        log("best_score = " << result_score << ", depth " << completed
+                << ", " << telemetry.nodes - nodes << " nodes");
+        if (transpositions.enabled()) {
+            log("transpositions: " << telemetry.tt_hits - tt_hits << " hits of "
+                    << telemetry.tt_probes - tt_probes << " probes, "
+                    << transpositions.used << " of " << transpositions.size() << " entries");
+        }
+        if (settings.branch_and_bound) {
+            log("bounds cut " << telemetry.pruned - pruned << " subtrees");
+        }
+        if (dominance.enabled()) {
+            log("dominance skipped " << telemetry.dominated - dominated << " states");
+        }
+        if (lazy) {
+            log("distance rows: " << lazy_distances.hits << " hits, "
+                    << lazy_distances.misses << " misses");
+        }
+        if (settings.plan_cache) {
+            remember(state, action_points, result_score);
+        }
+        return result;
+    }
+
+    // The cached plan's next action when the world is as the plan expects.
+    bool replay(const State& state, int action_points, Action& action) {
+        if (plans.trooper != self.getId() || plans.next >= plans.line.size()) {
+            return false;
+        }
+        if (!plans.matches(self, world)) {
+            log("plan broken after " << plans.next << " actions");
+            telemetry.plan_misses += 1;
+            plans.trooper = -1;
+            return false;
+        }
+        action = plans.line[plans.next];
+        if (!expect(state, action_points, action)) {
+            telemetry.plan_misses += 1;
+            plans.trooper = -1;
+            return false;
+        }
+        telemetry.plan_hits += 1;
+        telemetry.best_score = plans.score;
+        log("planned " << action.getAction() << ", " << plans.line.size() - plans.next << " more");
+        return true;
+    }
+
+    // Keeps the line just searched, to be played on from its first action.
+    void remember(const State& state, int action_points, int score) {
+        plans.trooper = -1;
+        if (lines.result.empty()) {
+            return;
+        }
+        plans.world_move = world.getMoveIndex();
+        plans.target = target;
+        plans.score = score;
+        plans.troopers = world.getTroopers();
+        plans.line = lines.result;
+        plans.next = 0;
+        if (expect(state, action_points, plans.line[0])) {
+            plans.trooper = self.getId();
+        }
+    }
+
+    // Where the plan's next action, about to be played, takes the trooper.
+    bool expect(const State& state, int action_points, const Action& action) {
+        bool found = false;
+        for_each_action(state, action_points,
+                [&](const Action& next, int points, const State& next_state) {
+            if (!found && next.getAction() == action.getAction() &&
+                    next.getX() == action.getX() && next.getY() == action.getY()) {
+                State expected = next_state;
+                pick_up(expected);
+                plans.pos = expected.pos;
+                plans.stance = expected.stance;
+                plans.action_points = points;
+                plans.has_medkit = expected.has_medkit;
+                plans.has_field_ration = expected.has_field_ration;
+                plans.has_grenade = expected.has_grenade;
+                found = true;
+            }
+        });
+        plans.next += 1;
+        return found;
+    }
+
+    // A state of the turn planner and the best way to reach it.
+    struct PlanNode {
+        State state;
+        int action_points;
+        int parent;             // in the layer before, -1 at the root
+        int sequence;           // of the action among the parent's ones
+        Action action;          // the one taken from the parent
+
+        // Layers are kept in the order the tree search visits their nodes.
+        bool operator<(const PlanNode& other) const {
+            return parent < other.parent ||
+                (parent == other.parent && sequence < other.sequence);
+        }
+    };
+
+    // What the leaf scores of the states below have in common: the cell,
+    // stance, items, action points and canonical order decide which
+    // actions follow and what they add, and mate damage decides the
+    // target term while there is no damage.
+    unsigned long long plan_key(const State& state, int action_points) const {
+        bool hit = state.damage != 0;
+        return
+            (unsigned long long) (state.pos.x * sizeY + state.pos.y) << 48 |
+            (unsigned long long) state.stance << 44 |
+            (unsigned long long) state_flags(state) << 36 |
+            (unsigned long long) state.order << 28 |
+            (unsigned long long) (unsigned char) action_points << 20 |
+            (unsigned long long) hit << 16 |
+            (hit ? 0 : (unsigned short) state.mate_damage);
+    }
+
+    // The part of the leaf score the actions add up.
+    static long long gained(const State& state) {
+        return 300LL * state.damage + 20000LL * state.kills - 2000LL * state.mate_damage;
+    }
+
+    // Whether the tree search visits the first node before the second one.
+    static bool visited_before(const vector< vector< PlanNode > >& layers,
+            int layer, int node, int other_layer, int other_node) {
+        bool shorter = layer < other_layer;
+        for (; layer > other_layer; layer -= 1) {
+            node = layers[layer][node].parent;
+        }
+        for (; other_layer > layer; other_layer -= 1) {
+            other_node = layers[other_layer][other_node].parent;
+        }
+        // A line comes right before the ones it starts.
+        return node == other_node ? shorter : node < other_node;
+    }
+
+    // The search as layered dynamic programming: layer k holds every
+    // state k actions reach, once per plan_key() with the most gained, so
+    // lines that end up alike are expanded once.  The leaf score only
+    // depends on the key and the gain, and of equal leaves the one the
+    // tree search visits first is kept, so both pick the same action.
+    Action plan(const State& root, int action_points, int& score, int& completed) {
+        static vector< vector< PlanNode > > layers;
+        static unordered_map< unsigned long long, int > index;
+
+        layers.resize(max(layers.size(), (size_t) settings.search_depth + 1));
+        layers[0].clear();
+        PlanNode start = {root, action_points, -1, 0, make_action(END_TURN)};
+        pick_up(start.state);
+        layers[0].push_back(start);
+
+        int best_layer = 0;
+        int best_node = 0;
+        int mates_dist;
+        int target_dist;
+        bool reachable;
+        score = evaluate(start.state, mates_dist, target_dist, reachable);
+        telemetry.nodes += 1;
+
+        completed = 0;
+        for (int k = 0; k < settings.search_depth && !layers[k].empty(); k += 1) {
+            vector< PlanNode >& layer = layers[k];
+            vector< PlanNode >& next_layer = layers[k + 1];
+            next_layer.clear();
+            index.clear();
+            for (size_t i = 0; i < layer.size(); i += 1) {
+                int sequence = 0;
+                for_each_action(layer[i].state, layer[i].action_points,
+                        [&](const Action& action, int points, const State& next) {
+                    PlanNode node = {next, points, (int) i, sequence, action};
+                    sequence += 1;
+                    pick_up(node.state);
+                    auto found = index.insert(make_pair(
+                                plan_key(node.state, points), (int) next_layer.size()));
+                    if (found.second) {
+                        next_layer.push_back(node);
+                    }
+                    else if (gained(node.state) > gained(next_layer[found.first->second].state)) {
+                        next_layer[found.first->second] = node;
+                    }
+                });
+                if (sequence > 0) {
+                    telemetry.expanded += 1;
+                }
+            }
+            // A better line replaces a node in place, out of visiting order.
+            sort(next_layer.begin(), next_layer.end());
+
+            for (size_t i = 0; i < next_layer.size(); i += 1) {
+                telemetry.nodes += 1;
+                int leaf = evaluate(next_layer[i].state, mates_dist, target_dist, reachable);
+                if (leaf > score || (leaf == score &&
+                            visited_before(layers, k + 1, i, best_layer, best_node))) {
+                    score = leaf;
+                    best_layer = k + 1;
+                    best_node = i;
+                }
+            }
+            completed = k + 1;
+            if (budget > 0 && Clock::now() >= deadline) {
+                log("layer " << completed << " out of time");
+                break;
+            }
+        }
+
+        lines.result.clear();
+        for (int k = best_layer, i = best_node; k > 0; k -= 1) {
+            lines.result.push_back(layers[k][i].action);
+            i = layers[k][i].parent;
+        }
+        reverse(lines.result.begin(), lines.result.end());
+#ifdef SLAVA_DEBUG
+        ostringstream actions;
+        for (auto& action : lines.result) {
+            actions << " " << action.getAction();
+        }
+        log("plan:" << actions.str() << ", " << layers[completed].size() << " states in the last layer");
+#endif
+        return lines.result.empty() ? make_action(END_TURN) : lines.result[0];
     }
 
     void maximize_score(int action_number, const int action_points, State state) {
+        if (aborted) {
+            return;
+        }
         action_number += 1;
+        telemetry.nodes += 1;
+        if (budget > 0 && telemetry.nodes % 256 == 0 &&
+                Clock::now() >= deadline) {
+            aborted = true;
+            return;
+        }
+
+        pick_up(state);
 
+        bool prune = false;
+        {
+            int mates_dist;
+            int target_dist;
+            bool reachable;
+            int score = evaluate(state, mates_dist, target_dist, reachable);
+
+            if (score > best_score) {
+                best_action = cur_action;
+                best_score = score;
+                lines.best = lines.path;
+            }
+
+            prune = settings.branch_and_bound && action_number <= depth && reachable &&
+                upper_bound(state, action_points, mates_dist, target_dist) <= best_score;
+        }
+
+        if (action_number > depth) {
+            truncated = truncated || action_points > 0;
+            return;
+        }
+
+        // Nothing below can beat the best score, and ties never replace it.
+        // Whether a line below would have run into the depth is not known,
+        // so it is assumed whenever the points allow one.
+        if (prune) {
+            telemetry.pruned += 1;
+            truncated = truncated ||
+                (depth + 1 - action_number) * bounds.cheapest_action <
+                available_points(state, action_points);
+            return;
+        }
+
+        // Every line below scores no more than it did after the dominating
+        // state, which has been or is being expanded.
+        if (dominance.enabled()) {
+            DominanceIndex::Entry entry = {action_points, depth + 1 - action_number,
+                state.damage, state.kills, state.mate_damage, state.order};
+            if (dominance.dominated(state_group(state), entry)) {
+                return;
+            }
+        }
+
+        // Everything below depends on the state and action points only, and
+        // a subtree explored again can at best tie with the best score.
+        if (transpositions.enabled() &&
+                transpositions.visit(state_key(state, action_points), depth + 1 - action_number,
+                    state.order)) {
+            return;
+        }
+        long long visited = telemetry.nodes;
+        for_each_action(state, action_points,
+                [&](const Action& action, int points, const State& next) {
+            if (action_number == 1) {
+                cur_action = action;
+            }
+            lines.path.push_back(action);
+            maximize_score(action_number, points, next);
+            lines.path.pop_back();
+        });
+
+        if (telemetry.nodes > visited) {
+            telemetry.expanded += 1;
+        }
+    }
+
+    // Items on the state's cell are picked up as the trooper steps there.
+    void pick_up(State& state) const {
         for (auto& bonus : world.getBonuses()) {
             if (state.pos == bonus) {
                 if (bonus.getType() == MEDIKIT) {
@@ -248,6 +989,9 @@ struct SlavaStrategy {
                 }
                 else if (bonus.getType() == FIELD_RATION) {
                     if (!state.used_field_ration) {
+                        if (!state.has_field_ration && settings.canonical_order) {
+                            state.order = ranks.eat;
+                        }
                         state.has_field_ration = true;
                     }
                 }
@@ -258,26 +1002,36 @@ struct SlavaStrategy {
                 }
             }
         }
+    }
 
-        {
-            int mates_dist = 0;
-            bool close_to_commander = false;
-            for (auto& mate : teammates) {
-                mates_dist += min_distance(state.pos, mate);
-                if (mate.getType() == COMMANDER &&
-                        state.pos.distance_to(mate) <= game.getCommanderAuraRange()) {
-                    close_to_commander = true;
-                }
+    // The leaf score of a state, and the distances upper_bound() reads.
+    int evaluate(const State& state, int& mates_dist, int& target_dist,
+            bool& reachable) const {
+        mates_dist = 0;
+        reachable = true;
+        bool close_to_commander = false;
+        for (auto& mate : teammates) {
+            int mate_dist = min_distance(state.pos, mate);
+            mates_dist += mate_dist;
+            reachable = reachable && mate_dist < inf;
+            if (mate.getType() == COMMANDER &&
+                    state.pos.distance_to(mate) <= game.getCommanderAuraRange()) {
+                close_to_commander = true;
             }
+        }
 
-            int shooting_enemies = 0;
+        int shooting_enemies = 0;
+        if (settings.threat_map) {
+            shooting_enemies = threats.count(state.pos, state.stance);
+        }
+        else {
             for (auto& enemy : enemies) {
                 bool is_shooting = false;
                 if (state.pos.distance_to(enemy) <= game.getGrenadeThrowRange()) {
                     is_shooting = true;
                 }
                 else {
-                    for (auto& stance : stances) {
+                    for (auto& stance : enemy_stances) {
                         if (world.isVisible(enemy.getShootingRange(),
                                     enemy.getX(), enemy.getY(), stance,
                                     state.pos.x, state.pos.y, state.stance)) {
@@ -289,68 +1043,60 @@ struct SlavaStrategy {
                     shooting_enemies += 1;
                 }
             }
-
-            int target_dist = min_distance(state.pos, target);
-
-            int score = 0;
-            score -= 2000  * state.mate_damage;
-            score += 300   * state.damage;
-            score += 20000 * state.kills;
-            score -= 10000 * shooting_enemies;
-            score += 400   * state.has_medkit;
-            score += 400   * state.has_field_ration;
-            score += 400   * state.has_grenade;
-            score -= 60    * mates_dist / teammates.size();
-            if (state.mate_damage >= 0 && state.damage == 0) {
-                score -= 55 * target_dist;
-            }
-            if (self.getType() != SCOUT) {
-                score += 500 * close_to_commander;
-            }
-
-            if (score > best_score) {
-                best_action = cur_action;
-                best_score = score;
-            }
         }
 
-        if (action_number == 11) {
-            return;
+        target_dist = min_distance(state.pos, target);
+
+        int score = 0;
+        score -= 2000  * state.mate_damage;
+        score += 300   * state.damage;
+        score += 20000 * state.kills;
+        score -= 10000 * shooting_enemies;
+        score += 400   * state.has_medkit;
+        score += 400   * state.has_field_ration;
+        score += 400   * state.has_grenade;
+        score -= 60    * mates_dist / teammates.size();
+        if (state.mate_damage >= 0 && state.damage == 0) {
+            score -= 55 * target_dist;
         }
+        if (self.getType() != SCOUT) {
+            score += 500 * close_to_commander;
+        }
+        return score;
+    }
 
+    // Calls visit(action, points left, state after it) for every action
+    // the state allows, in the order the search tries them.
+    template < typename Visit >
+    void for_each_action(const State& state, int action_points, Visit visit) const {
         if (state.has_medkit) {
             int points = action_points - game.getMedikitUseCost();
             if (points >= 0) {
-                for (auto& mate : teammates) {
-                    if (!state.pos.has_neigh(mate)) {
+                for (size_t i = 0; i < teammates.size(); i += 1) {
+                    auto& mate = teammates[i];
+                    if (!state.pos.has_neigh(mate) || !in_order(state, ranks.medkit + i)) {
                         continue;
                     }
                     int heal = min(
                             game.getMedikitBonusHitpoints(),
                             mate.getMaximalHitpoints() - mate.getHitpoints());
                     if (heal > 0) {
-                        State new_state = state;
+                        State new_state = after(state, ranks.medkit + i);
                         new_state.mate_damage -= heal;
                         new_state.has_medkit = false;
-                        if (action_number == 1) {
-                            cur_action = make_action(USE_MEDIKIT, mate);
-                        }
-                        maximize_score(action_number, points, new_state);
+                        visit(make_action(USE_MEDIKIT, mate), points, new_state);
                     }
                 }
 
-                {
+                if (in_order(state, ranks.medkit + teammates.size())) {
                     int heal = min(
                             game.getMedikitHealSelfBonusHitpoints(),
                             self.getMaximalHitpoints() - self.getHitpoints());
                     if (heal > 0) {
-                        State new_state = state;
+                        State new_state = after(state, ranks.medkit + teammates.size());
                         new_state.mate_damage -= heal;
                         new_state.has_medkit = false;
-                        if (action_number == 1) {
-                            cur_action = make_action(USE_MEDIKIT, self);
-                        }
-                        maximize_score(action_number, points, new_state);
+                        visit(make_action(USE_MEDIKIT, self), points, new_state);
                     }
                 }
             }
@@ -359,10 +1105,12 @@ struct SlavaStrategy {
         if (state.has_grenade) {
             int points = action_points - game.getGrenadeThrowCost();
             if (points >= 0) {
-                for (auto& enemy : enemies) {
+                for (size_t i = 0; i < enemies.size(); i += 1) {
+                    auto& enemy = enemies[i];
                     Point e(enemy);
-                    if (state.pos.distance_to(e) <= game.getGrenadeThrowRange()) {
-                        State new_state = state;
+                    if (state.pos.distance_to(e) <= game.getGrenadeThrowRange() &&
+                            in_order(state, ranks.grenade + i)) {
+                        State new_state = after(state, ranks.grenade + i);
                         {
                             int damage = game.getGrenadeDirectDamage();
                             new_state.damage += game.getGrenadeDirectDamage();
@@ -390,10 +1138,7 @@ struct SlavaStrategy {
                         }
                         new_state.has_grenade = false;
                         new_state.used_grenade = true;
-                        if (action_number == 1) {
-                            cur_action = make_action(THROW_GRENADE, e);
-                        }
-                        maximize_score(action_number, points, new_state);
+                        visit(make_action(THROW_GRENADE, e), points, new_state);
                     }
                 }
             }
@@ -403,34 +1148,29 @@ struct SlavaStrategy {
         if (self.getType() == FIELD_MEDIC) {
             int points = action_points - game.getFieldMedicHealCost();
             if (points >= 0) {
-                for (auto& mate : teammates) {
-                    if (!state.pos.has_neigh(mate)) {
+                for (size_t i = 0; i < teammates.size(); i += 1) {
+                    auto& mate = teammates[i];
+                    if (!state.pos.has_neigh(mate) || !in_order(state, ranks.heal + i)) {
                         continue;
                     }
                     int heal = min(
                             game.getFieldMedicHealBonusHitpoints(),
                             mate.getMaximalHitpoints() - mate.getHitpoints());
                     if (heal > 0) {
-                        State new_state = state;
+                        State new_state = after(state, ranks.heal + i);
                         new_state.mate_damage -= heal;
-                        if (action_number == 1) {
-                            cur_action = make_action(HEAL, mate);
-                        }
-                        maximize_score(action_number, points, new_state);
+                        visit(make_action(HEAL, mate), points, new_state);
                     }
                 }
 
-                {
+                if (in_order(state, ranks.heal + teammates.size())) {
                     int heal = min(
                             game.getFieldMedicHealSelfBonusHitpoints(),
                             self.getMaximalHitpoints() - self.getHitpoints());
                     if (heal > 0) {
-                        State new_state = state;
+                        State new_state = after(state, ranks.heal + teammates.size());
                         new_state.mate_damage -= heal;
-                        if (action_number == 1) {
-                            cur_action = make_action(HEAL, self);
-                        }
-                        maximize_score(action_number, points, new_state);
+                        visit(make_action(HEAL, self), points, new_state);
                     }
                 }
             }
@@ -439,20 +1179,19 @@ struct SlavaStrategy {
         {
             int points = action_points - self.getShootCost();
             if (points >= 0) {
-                for (auto& enemy : enemies) {
-                    if (world.isVisible(self.getShootingRange(),
+                for (size_t i = 0; i < enemies.size(); i += 1) {
+                    auto& enemy = enemies[i];
+                    if (in_order(state, ranks.shoot + i) &&
+                            world.isVisible(self.getShootingRange(),
                                 state.pos.x, state.pos.y, state.stance,
                                 enemy.getX(), enemy.getY(), enemy.getStance())) {
-                        State new_state = state;
+                        State new_state = after(state, ranks.shoot + i);
                         int damage = self.getDamage(state.stance);
                         new_state.damage += damage;
                         if (damage >= enemy.getHitpoints()) {
                             new_state.kills += 1;
                         }
-                        if (action_number == 1) {
-                            cur_action = make_action(SHOOT, enemy);
-                        }
-                        maximize_score(action_number, points, new_state);
+                        visit(make_action(SHOOT, enemy), points, new_state);
                     }
                 }
             }
@@ -466,13 +1205,10 @@ struct SlavaStrategy {
             int points = action_points - cost;
             if (points >= 0) {
                 for (auto& n : state.pos.neighs()) {
-                    if (cells[n.x][n.y] == FREE) {
-                        State new_state = state;
+                    if (cells[n.x][n.y] == FREE && !occupied[n.x * sizeY + n.y]) {
+                        State new_state = after(state, ranks.medkit);
                         new_state.pos = n;
-                        if (action_number == 1) {
-                            cur_action = make_action(MOVE, n);
-                        }
-                        maximize_score(action_number, points, new_state);
+                        visit(make_action(MOVE, n), points, new_state);
                     }
                 }
             }
@@ -482,86 +1218,159 @@ struct SlavaStrategy {
             int points = action_points - game.getStanceChangeCost();
             if (points >= 0) {
                 if (state.stance != STANDING) {
-                    State new_state = state;
+                    State new_state = after(state, ranks.shoot);
                     new_state.stance = state.stance == PRONE ? KNEELING : STANDING;
-                    if (action_number == 1) {
-                        cur_action = make_action(RAISE_STANCE);
-                    }
-                    maximize_score(action_number, points, new_state);
+                    visit(make_action(RAISE_STANCE), points, new_state);
                 }
                 if (state.stance != PRONE) {
-                    State new_state = state;
+                    State new_state = after(state, ranks.shoot);
                     new_state.stance = state.stance == STANDING ? KNEELING : PRONE;
-                    if (action_number == 1) {
-                        cur_action = make_action(LOWER_STANCE);
-                    }
-                    maximize_score(action_number, points, new_state);
+                    visit(make_action(LOWER_STANCE), points, new_state);
                 }
             }
         }
 
-        if (state.has_field_ration) {
+        if (state.has_field_ration && in_order(state, ranks.eat)) {
             int points = action_points - game.getFieldRationEatCost();
             if (points >= 0) {
-                State new_state = state;
+                State new_state = after(state, ranks.eat);
                 points += game.getFieldRationBonusActionPoints();
                 new_state.has_field_ration = false;
                 new_state.used_field_ration = true;
-                if (action_number == 1) {
-                    cur_action = make_action(EAT_FIELD_RATION);
-                }
-                maximize_score(action_number, points, new_state);
+                visit(make_action(EAT_FIELD_RATION), points, new_state);
             }
         }
     }
 
-    void floyd() {
-        log("floyd start");
+    bool in_order(const State& state, int rank) const {
+        return !settings.canonical_order || rank >= state.order;
+    }
 
-        vector< Point > free_points;
-        for (int x = 0; x < sizeX; x += 1) {
-            for (int y = 0; y < sizeY; y += 1) {
-                if (world.getCells()[x][y] == FREE) {
-                    free_points.push_back(Point(x, y));
-                }
-            }
+    // The state an action of the given rank starts from.
+    State after(const State& state, int rank) const {
+        State next = state;
+        if (settings.canonical_order) {
+            next.order = rank;
         }
+        return next;
+    }
 
-        floyd_dist.resize(sizeX, vector< vector< vector< int > > >(sizeY,
-                    vector< vector< int > >(sizeX, vector< int >(sizeY, inf))));
-#define at2(t, p, q) (t[p.x][p.y][q.x][q.y])
-        for (auto& p : free_points) {
-            for (auto& n : p.neighs()) {
-                if (world.getCells()[n.x][n.y] != FREE) {
-                    continue;
-                }
-                at2(floyd_dist, p, n) = 1;
-            }
+    int available_points(const State& state, int action_points) const {
+        bool ration = state.has_field_ration || (bounds.ration_bonus && !state.used_field_ration);
+        return action_points + (ration ? bounds.ration_points : 0);
+    }
+
+    // The most any state below can score; see SearchBounds.  The terms
+    // follow the leaf evaluation in maximize_score().
+    long long upper_bound(const State& state, int action_points,
+            int mates_dist, int target_dist) const {
+        int points = available_points(state, action_points);
+        int steps = points / bounds.cheapest_move;
+        bool medkit = state.has_medkit || bounds.medkit_bonus;
+        bool ration = state.has_field_ration || (bounds.ration_bonus && !state.used_field_ration);
+        bool grenade = state.has_grenade || (bounds.grenade_bonus && !state.used_grenade);
+        int mates = teammates.size();
+
+        long long upper = 0;
+        upper -= 2000LL  * state.mate_damage;
+        upper += 300LL   * state.damage;
+        upper += 20000LL * state.kills;
+        upper += (long long) ceil(bounds.gain_per_point * points);
+        upper += grenade ? bounds.grenade_gain : 0;
+        upper -= 10000LL * bounds.threat_floor;
+        upper += 400 * medkit;
+        upper += 400 * ration;
+        upper += 400 * grenade;
+        upper -= 60LL * max(0, mates_dist - steps * mates) / mates;
+        // Damage or a heal would drop the target term altogether.
+        if (state.mate_damage >= 0 && state.damage == 0 && enemies.empty() && !bounds.can_heal) {
+            upper -= 55LL * max(0, target_dist - steps);
         }
-        for (auto& k : free_points) {
-            for (auto& i : free_points) {
-                if (at2(floyd_dist, i, k) == inf) {
-                    continue;
-                }
-                for (auto& j : free_points) {
-                    if (at2(floyd_dist, k, j) == inf) {
-                        continue;
-                    }
-                    at2(floyd_dist, i, j) = min(at2(floyd_dist, i, j), at2(floyd_dist, i, k) + at2(floyd_dist, k, j));
-                }
+        upper += bounds.commander_bonus;
+        return upper;
+    }
+
+    int state_flags(const State& state) const {
+        return
+            state.has_medkit << 0 |
+            state.has_field_ration << 1 |
+            state.used_field_ration << 2 |
+            state.has_grenade << 3 |
+            state.used_grenade << 4;
+    }
+
+    unsigned long long state_key(const State& state, int action_points) const {
+        return transpositions.key(state.pos.x * sizeY + state.pos.y, state.stance,
+                state_flags(state), action_points, state.damage, state.mate_damage, state.kills);
+    }
+
+    int state_group(const State& state) const {
+        return ((state.pos.x * sizeY + state.pos.y) * _TROOPER_STANCE_COUNT_ + state.stance) << 5 |
+            state_flags(state);
+    }
+
+    void compute_distances() {
+        bool built;
+        if (distance_worker.started) {
+#ifdef SLAVA_DEBUG
+            typedef DistanceWorker::Clock Clock;
+            Clock::time_point wait = Clock::now();
+#endif
+            if (distance_worker.worker.joinable()) {
+                distance_worker.worker.join();
             }
+            built = distance_worker.built;
+
+#ifdef SLAVA_DEBUG
+            Clock::time_point done = Clock::now();
+            auto ms = [](Clock::duration d) {
+                return chrono::duration< double, milli >(d).count();
+            };
+            log("distances took " << ms(distance_worker.end - distance_worker.start)
+                    << " ms, " << ms(min(distance_worker.end, wait) - distance_worker.start)
+                    << " ms of it while reading the context, waited " << ms(done - wait) << " ms");
+#endif
+        }
+        else {
+            log("distances start");
+            built = prepare_distances(world.getCells());
+            log("distances end");
         }
-#undef at2
 
-        log("floyd end");
+        if (built && !settings.cache_dir.empty()) {
+            MapCache::save(settings.cache_dir, world.getCells(),
+                    distances, world.getCellVisibilities());
+        }
     }
 };
 
 MyStrategy::MyStrategy() {}
 
+void MyStrategy::prepare(const Cells& cells, const MapCache& cache) {
+    if (!distance_worker.started) {
+        distance_worker.started = true;
+        try {
+            distance_worker.worker = thread(&DistanceWorker::run, &distance_worker,
+                    cref(cells), cref(cache));
+        }
+        catch (const system_error&) {
+            distance_worker.run(cells, cache);
+        }
+    }
+}
+
 void MyStrategy::move(const Trooper& self,
         const World& world, const Game& game, Action& action) {
+    time_budget.start_move();
     SlavaStrategy strategy(self, world, game);
+    if (settings.game_time > 0) {
+        double allowance = time_budget.allowance(settings.game_time, settings.time_reserve,
+                world.getMoveIndex(), game.getMoveCount());
+        strategy.budget = strategy.budget > 0 ? min(strategy.budget, allowance) : allowance;
+    }
     action = strategy.run();
     log("action = " << action.getAction() << " " << action.getX() << " " << action.getY());
+    time_budget.end_move();
+    log("time: " << time_budget.last_cpu << " cpu, " << time_budget.last_wall << " wall, "
+            << time_budget.cpu << " cpu in game, allowed " << strategy.budget);
 }
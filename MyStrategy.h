@@ -3,11 +3,20 @@
 #ifndef _MY_STRATEGY_H_
 #define _MY_STRATEGY_H_
 
+#include <vector>
+
+#include "MapCache.h"
 #include "Strategy.h"
 
 class MyStrategy : public Strategy {
 public:
     MyStrategy();
+
+    // Starts the per-map precomputation as soon as the cells are known,
+    // reading the distances from cache when it is mapped.
+    static void prepare(const std::vector<std::vector<model::CellType> >& cells,
+            const MapCache& cache);
+
     void move(const model::Trooper& self, const model::World& world, const model::Game& game, model::Move& move);
 };
 
@@ -2,6 +2,10 @@
 
 #include <algorithm>
 #include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#include "Settings.h"
 
 using namespace model;
 using namespace std;
@@ -9,16 +13,33 @@ using namespace std;
 const bool LITTLE_ENDIAN_BYTE_ORDER = true;
 const int INTEGER_SIZE_BYTES = sizeof(int);
 const int LONG_SIZE_BYTES = sizeof(long long);
-
-RemoteProcessClient::RemoteProcessClient(string host, int port) {
-    socket.Initialize();
-    socket.DisableNagleAlgoritm();
-
-    if (!socket.Open((uint8*) host.c_str(), (int16) port)) {
+const int INPUT_CHUNK_BYTES = 1 << 16;
+
+RemoteProcessClient::RemoteProcessClient(string host, int port)
+: inputPosition(0), inputLimit(0) {
+    if (!settings.replay_file.empty()) {
+        ReplayTransport* replay = new ReplayTransport();
+        if (!replay->open(settings.replay_file)) {
+            exit(10001);
+        }
+        transport = replay;
+    } else if ((transport = connectTransport(host, port)) == NULL) {
         exit(10001);
     }
 
+    if (!settings.record_file.empty()) {
+        transport = new RecordingTransport(transport, settings.record_file);
+    }
+
+    cells = NULL;
+    cellsHandler = NULL;
+    cellVisibilities = NULL;
+}
+
+RemoteProcessClient::RemoteProcessClient(Transport* transport)
+: transport(transport), inputPosition(0), inputLimit(0) {
     cells = NULL;
+    cellsHandler = NULL;
     cellVisibilities = NULL;
 }
 
@@ -30,11 +51,18 @@ RemoteProcessClient::~RemoteProcessClient() {
     if (cellVisibilities != NULL) {
         delete cellVisibilities;
     }
+
+    delete transport;
+}
+
+void RemoteProcessClient::setCellsHandler(CellsHandler handler) {
+    cellsHandler = handler;
 }
 
 void RemoteProcessClient::writeToken(const string& token) {
     writeEnum(AUTHENTICATION_TOKEN);
     writeString(token);
+    flush();
 }
 
 int RemoteProcessClient::readTeamSize() {
@@ -45,6 +73,7 @@ int RemoteProcessClient::readTeamSize() {
 void RemoteProcessClient::writeProtocolVersion() {
     writeEnum(PROTOCOL_VERSION);
     writeInt(2);
+    flush();
 }
 
 Game RemoteProcessClient::readGameContext() {
@@ -116,7 +145,7 @@ PlayerContext* RemoteProcessClient::readPlayerContext() {
     Trooper trooper = readTrooper();
     World world = readWorld();
 
-    return new PlayerContext(trooper, world);
+    return new PlayerContext(std::move(trooper), std::move(world));
 }
 
 void RemoteProcessClient::writeMove(const Move& move) {
@@ -128,10 +157,11 @@ void RemoteProcessClient::writeMove(const Move& move) {
     writeEnum((signed char) move.getDirection());
     writeInt(move.getX());
     writeInt(move.getY());
+    flush();
 }
 
 void RemoteProcessClient::close() {
-    socket.Close();
+    transport->close();
 }
 
 World RemoteProcessClient::readWorld() {
@@ -146,9 +176,10 @@ World RemoteProcessClient::readWorld() {
     vector<Trooper> troopers = readTroopers();
     vector<Bonus> bonuses = readBonuses();
     vector<vector<CellType> >& cells = readCells();
-    vector<bool>& cellVisibilities = readCellVisibilities();
+    VisibilityMatrix& cellVisibilities = readCellVisibilities();
 
-    return World(moveIndex, width, height, players, troopers, bonuses, cells, cellVisibilities);
+    return World(moveIndex, width, height, std::move(players), std::move(troopers),
+            std::move(bonuses), cells, cellVisibilities);
 }
 
 vector<Player> RemoteProcessClient::readPlayers() {
@@ -169,7 +200,7 @@ vector<Player> RemoteProcessClient::readPlayers() {
             int approximateX = readInt();
             int approximateY = readInt();
 
-            players.push_back(Player(id, name, score, strategyCrashed, approximateX, approximateY));
+            players.push_back(Player(id, std::move(name), score, strategyCrashed, approximateX, approximateY));
         } else {
             exit(10004);
         }
@@ -282,10 +313,18 @@ vector<vector<CellType> >& RemoteProcessClient::readCells() {
         }
     }
 
+    if (!settings.cache_dir.empty()) {
+        mapCache.open(settings.cache_dir, *cells);
+    }
+
+    if (cellsHandler != NULL) {
+        cellsHandler(*cells, mapCache);
+    }
+
     return *cells;
 }
 
-vector<bool>& RemoteProcessClient::readCellVisibilities() {
+VisibilityMatrix& RemoteProcessClient::readCellVisibilities() {
     if (cellVisibilities != NULL) {
         return *cellVisibilities;
     }
@@ -305,12 +344,24 @@ vector<bool>& RemoteProcessClient::readCellVisibilities() {
         exit(10020);
     }
 
-    int rawVisibilityCount = worldWidth * worldHeight * worldWidth * worldHeight * stanceCount;
-    vector<signed char> rawVisibilities = readBytes(rawVisibilityCount);
-    cellVisibilities = new vector<bool>(rawVisibilityCount);
+    cellVisibilities = new VisibilityMatrix(worldWidth, worldHeight, stanceCount);
 
-    for (int rawVisibilityIndex = 0; rawVisibilityIndex < rawVisibilityCount; ++rawVisibilityIndex) {
-        (*cellVisibilities)[rawVisibilityIndex] = rawVisibilities[rawVisibilityIndex] != 0;
+    bool cached = mapCache.mapped != NULL && mapCache.header().visibility_bytes
+            == (unsigned long long) cellVisibilities->getWordCount() * sizeof(unsigned long long);
+    if (cached) {
+        cellVisibilities->attach(mapCache.visibility_words());
+    }
+
+    // The raw cube is packed one viewer at a time straight out of the
+    // input buffer, which never has to hold all of it.
+    int viewerByteCount = worldWidth * worldHeight * stanceCount;
+    for (int viewerX = 0; viewerX < worldWidth; ++viewerX) {
+        for (int viewerY = 0; viewerY < worldHeight; ++viewerY) {
+            const signed char* rawVisibilities = readBytes(viewerByteCount);
+            if (!cached) {
+                cellVisibilities->setViewer(viewerX, viewerY, rawVisibilities);
+            }
+        }
     }
 
     return *cellVisibilities;
@@ -327,9 +378,7 @@ signed char RemoteProcessClient::readEnum() {
 }
 
 void RemoteProcessClient::writeEnum(signed char value) {
-    vector<signed char> bytes;
-    bytes.push_back(value);
-    this->writeBytes(bytes);
+    this->writeBytes(&value, 1);
 }
 
 string RemoteProcessClient::readString() {
@@ -338,17 +387,13 @@ string RemoteProcessClient::readString() {
         exit(10014);
     }
 
-    vector<signed char> bytes = this->readBytes(length);
-    return string((char*) (&bytes[0]), length);
+    const signed char* bytes = this->readBytes(length);
+    return string((const char*) bytes, length);
 }
 
 void RemoteProcessClient::writeString(const string& value) {
-    vector<signed char> bytes(value.size());
-    
-    memcpy(&bytes[0], value.c_str(), value.size());
-
-    this->writeInt(static_cast<int>(bytes.size()));
-    this->writeBytes(bytes);
+    this->writeInt(static_cast<int>(value.size()));
+    this->writeBytes((const signed char*) value.c_str(), value.size());
 }
 
 bool RemoteProcessClient::readBoolean() {
@@ -356,61 +401,64 @@ bool RemoteProcessClient::readBoolean() {
 }
 
 void RemoteProcessClient::writeBoolean(bool value) {
-    vector<signed char> bytes;
-    bytes.push_back((signed char) (value ? 1 : 0));
-    this->writeBytes(bytes);
+    signed char byte = (signed char) (value ? 1 : 0);
+    this->writeBytes(&byte, 1);
 }
 
 int RemoteProcessClient::readInt() {
-    vector<signed char> bytes = this->readBytes(INTEGER_SIZE_BYTES);
+    signed char bytes[INTEGER_SIZE_BYTES];
+
+    memcpy(bytes, this->readBytes(INTEGER_SIZE_BYTES), INTEGER_SIZE_BYTES);
 
     if (this->isLittleEndianMachine() != LITTLE_ENDIAN_BYTE_ORDER) {
-        reverse(&bytes[0], &bytes[INTEGER_SIZE_BYTES - 1]);
+        reverse(&bytes[0], &bytes[INTEGER_SIZE_BYTES]);
     }
 
     int value;
 
-    memcpy(&value, &bytes[0], INTEGER_SIZE_BYTES);
+    memcpy(&value, bytes, INTEGER_SIZE_BYTES);
 
     return value;
 }
 
 void RemoteProcessClient::writeInt(int value) {
-    vector<signed char> bytes(INTEGER_SIZE_BYTES);
+    signed char bytes[INTEGER_SIZE_BYTES];
 
-    memcpy(&bytes[0], &value, INTEGER_SIZE_BYTES);
+    memcpy(bytes, &value, INTEGER_SIZE_BYTES);
 
     if (this->isLittleEndianMachine() != LITTLE_ENDIAN_BYTE_ORDER) {
-        reverse(&bytes[0], &bytes[INTEGER_SIZE_BYTES - 1]);
+        reverse(&bytes[0], &bytes[INTEGER_SIZE_BYTES]);
     }
 
-    this->writeBytes(bytes);
+    this->writeBytes(bytes, INTEGER_SIZE_BYTES);
 }
 
 long long RemoteProcessClient::readLong() {
-    vector<signed char> bytes = this->readBytes(LONG_SIZE_BYTES);
+    signed char bytes[LONG_SIZE_BYTES];
+
+    memcpy(bytes, this->readBytes(LONG_SIZE_BYTES), LONG_SIZE_BYTES);
 
     if (this->isLittleEndianMachine() != LITTLE_ENDIAN_BYTE_ORDER) {
-        reverse(&bytes[0], &bytes[LONG_SIZE_BYTES - 1]);
+        reverse(&bytes[0], &bytes[LONG_SIZE_BYTES]);
     }
 
     long long value;
 
-    memcpy(&value, &bytes[0], LONG_SIZE_BYTES);
+    memcpy(&value, bytes, LONG_SIZE_BYTES);
 
     return value;
 }
 
 void RemoteProcessClient::writeLong(long long value) {
-    vector<signed char> bytes(LONG_SIZE_BYTES);
+    signed char bytes[LONG_SIZE_BYTES];
 
-    memcpy(&bytes[0], &value, LONG_SIZE_BYTES);
+    memcpy(bytes, &value, LONG_SIZE_BYTES);
 
     if (this->isLittleEndianMachine() != LITTLE_ENDIAN_BYTE_ORDER) {
-        reverse(&bytes[0], &bytes[LONG_SIZE_BYTES - 1]);
+        reverse(&bytes[0], &bytes[LONG_SIZE_BYTES]);
     }
 
-    this->writeBytes(bytes);
+    this->writeBytes(bytes, LONG_SIZE_BYTES);
 }
 
 double RemoteProcessClient::readDouble() {
@@ -422,35 +470,63 @@ void RemoteProcessClient::writeDouble(double value) {
     this->writeLong(*((long long*) &value));
 }
 
-vector<signed char> RemoteProcessClient::readBytes(unsigned int byteCount) {
-    vector<signed char> bytes(byteCount);
-    unsigned int offset = 0;
+// The returned bytes stay in the input buffer until the next read.
+const signed char* RemoteProcessClient::readBytes(unsigned int byteCount) {
+    if (inputLimit - inputPosition < byteCount) {
+        fillInputBuffer(byteCount);
+    }
+
+    const signed char* bytes = inputBuffer.data() + inputPosition;
+    inputPosition += byteCount;
+    return bytes;
+}
+
+// Receives whole chunks until byteCount unread bytes are buffered.  The
+// chunk size never changes, so the socket keeps its receive buffer.
+void RemoteProcessClient::fillInputBuffer(unsigned int byteCount) {
+    unsigned int unread = inputLimit - inputPosition;
+    if (unread > 0 && inputPosition > 0) {
+        memmove(inputBuffer.data(), inputBuffer.data() + inputPosition, unread);
+    }
+    inputPosition = 0;
+    inputLimit = unread;
+
+    if (inputBuffer.size() < byteCount + INPUT_CHUNK_BYTES) {
+        inputBuffer.resize(byteCount + INPUT_CHUNK_BYTES);
+    }
+
     int receivedByteCount;
 
-    while (offset < byteCount && (receivedByteCount = socket.Receive(byteCount - offset)) > 0) {
-        memcpy(&bytes[offset], socket.GetData(), receivedByteCount);
-        offset += receivedByteCount;
+    while (inputLimit < byteCount
+            && (receivedByteCount = transport->receive(inputBuffer.data() + inputLimit, INPUT_CHUNK_BYTES)) > 0) {
+        inputLimit += receivedByteCount;
     }
 
-    if (offset != byteCount) {
+    if (inputLimit < byteCount) {
         exit(10012);
     }
+}
 
-    return bytes;
+// Bytes wait in the output buffer until the message is flushed.
+void RemoteProcessClient::writeBytes(const signed char* bytes, unsigned int byteCount) {
+    outputBuffer.insert(outputBuffer.end(), bytes, bytes + byteCount);
 }
 
-void RemoteProcessClient::writeBytes(const vector<signed char>& bytes) {
-    vector<signed char>::size_type byteCount = bytes.size();
+// Sends the buffered message, normally with a single syscall.
+void RemoteProcessClient::flush() {
+    vector<signed char>::size_type byteCount = outputBuffer.size();
     unsigned int offset = 0;
     int sentByteCount;
 
-    while (offset < byteCount && (sentByteCount = socket.Send((uint8*) &bytes[offset], byteCount - offset)) > 0) {
+    while (offset < byteCount && (sentByteCount = transport->send(outputBuffer.data() + offset, byteCount - offset)) > 0) {
         offset += sentByteCount;
     }
 
     if (offset != byteCount) {
         exit(10013);
     }
+
+    outputBuffer.clear();
 }
 
 bool RemoteProcessClient::isLittleEndianMachine() {
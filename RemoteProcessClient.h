@@ -6,13 +6,15 @@
 #include <string>
 #include <vector>
 
-#include "csimplesocket/ActiveSocket.h"
+#include "MapCache.h"
+#include "Transport.h"
 #include "model/Bonus.h"
 #include "model/Game.h"
 #include "model/Move.h"
 #include "model/Player.h"
 #include "model/PlayerContext.h"
 #include "model/Trooper.h"
+#include "model/VisibilityMatrix.h"
 #include "model/World.h"
 
 enum MessageType {
@@ -26,11 +28,23 @@ enum MessageType {
     MOVE_MESSAGE
 };
 
+// cache is the client's mapping of the map cache, unmapped without a valid file.
+typedef void (*CellsHandler)(const std::vector<std::vector<model::CellType> >& cells,
+        const MapCache& cache);
+
 class RemoteProcessClient {
 private:
-    CActiveSocket socket;
+    Transport* transport;
     std::vector<std::vector<model::CellType> >* cells;
-    std::vector<bool>* cellVisibilities;
+    CellsHandler cellsHandler;
+    model::VisibilityMatrix* cellVisibilities;
+    MapCache mapCache;
+
+    std::vector<signed char> inputBuffer;
+    unsigned int inputPosition;
+    unsigned int inputLimit;
+
+    std::vector<signed char> outputBuffer;
 
     model::World readWorld();
     std::vector<model::Player> readPlayers();
@@ -38,7 +52,7 @@ private:
     model::Trooper readTrooper();
     std::vector<model::Bonus> readBonuses();
     std::vector<std::vector<model::CellType> >& readCells();
-    std::vector<bool>& readCellVisibilities();
+    model::VisibilityMatrix& readCellVisibilities();
 
     static void ensureMessageType(MessageType actualType, MessageType expectedType);
 
@@ -54,14 +68,25 @@ private:
     void writeLong(long long value);
     double readDouble();
     void writeDouble(double value);
-    std::vector<signed char> readBytes(unsigned int byteCount);
-    void writeBytes(const std::vector<signed char>& bytes);
+    const signed char* readBytes(unsigned int byteCount);
+    void fillInputBuffer(unsigned int byteCount);
+    void writeBytes(const signed char* bytes, unsigned int byteCount);
+    void flush();
 
     static bool isLittleEndianMachine();
 public:
+    // Connects to the runner at host, which may also be a "unix:" or
+    // "shm:" address (see connectTransport()), or replays $SLAVA_REPLAY
+    // instead; records to $SLAVA_RECORD when it is set.
     RemoteProcessClient(std::string host, int port);
+    // Takes ownership of transport.
+    RemoteProcessClient(Transport* transport);
     ~RemoteProcessClient();
 
+    // Called once the cells are read, before the visibilities that follow
+    // them in the first player context.
+    void setCellsHandler(CellsHandler handler);
+
     void writeToken(const std::string& token);
     int readTeamSize();
     void writeProtocolVersion();
@@ -25,6 +25,7 @@ Runner::Runner(const char* host, const char* port, const char* token)
 }
 
 void Runner::run() {
+    remoteProcessClient.setCellsHandler(MyStrategy::prepare);
     remoteProcessClient.writeToken(token);
     int teamSize = remoteProcessClient.readTeamSize();
     remoteProcessClient.writeProtocolVersion();
@@ -40,7 +41,7 @@ void Runner::run() {
     PlayerContext* playerContext;
 
     while ((playerContext = remoteProcessClient.readPlayerContext()) != NULL) {
-        Trooper playerTrooper = playerContext->getTrooper();
+        const Trooper& playerTrooper = playerContext->getTrooper();
 
         Move move;
         strategies[playerTrooper.getTeammateIndex()]->move(playerTrooper, playerContext->getWorld(), game, move);
@@ -0,0 +1,45 @@
+#include "Settings.h"
+
+#include <cstdlib>
+
+Settings settings;
+
+Settings::Settings():
+    distance_threads(0),
+    distance_table_max_cells(4096),
+    distance_cache_rows(64),
+    threat_map(true),
+    visible_threats(false),
+    transposition_bits(16),
+    branch_and_bound(true),
+    dominance_bits(14),
+    canonical_order(true),
+    plan_cache(true),
+    turn_planner(false),
+    search_depth(10),
+    move_budget(0),
+    deepening_step(4),
+    game_time(20),
+    time_reserve(0.25) {
+
+    const char* dir = getenv("SLAVA_CACHE_DIR");
+    if (dir != NULL) {
+        cache_dir = dir;
+    }
+    const char* record = getenv("SLAVA_RECORD");
+    if (record != NULL) {
+        record_file = record;
+    }
+    const char* replay = getenv("SLAVA_REPLAY");
+    if (replay != NULL) {
+        replay_file = replay;
+    }
+    const char* planner = getenv("SLAVA_PLANNER");
+    if (planner != NULL) {
+        turn_planner = atoi(planner) != 0;
+    }
+    const char* time = getenv("SLAVA_GAME_TIME");
+    if (time != NULL) {
+        game_time = atof(time);
+    }
+}
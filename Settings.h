@@ -0,0 +1,35 @@
+#pragma once
+
+#ifndef _SETTINGS_H_
+#define _SETTINGS_H_
+
+#include <string>
+
+// Strategy knobs that local runs and the benchmark may override.
+struct Settings {
+    int distance_threads;   // threads building the distance table, 0: all cores
+    int distance_table_max_cells;   // larger maps get lazy distance rows
+    int distance_cache_rows;        // rows kept by the lazy distances
+    bool threat_map;        // leaf evaluation reads a per-turn threat map
+    bool visible_threats;   // enemies in sight threaten on every move, not the first only
+    int transposition_bits; // log2 of transposition table buckets, 0: off
+    bool branch_and_bound;  // cut subtrees whose score bound cannot win
+    int dominance_bits;     // log2 of dominance index slots, 0: off
+    bool canonical_order;   // commuting actions are tried in one order only
+    bool plan_cache;        // play the last move's line on while the world allows
+    bool turn_planner;      // layered dynamic programming instead of the tree, $SLAVA_PLANNER
+    int search_depth;       // most actions the search looks ahead
+    double move_budget;     // seconds of search per move, 0: no limit
+    int deepening_step;     // depths apart the iterations under a budget search
+    double game_time;       // CPU seconds for the whole game, $SLAVA_GAME_TIME; 0: off
+    double time_reserve;    // part of game_time never handed out
+    std::string cache_dir;  // on-disk map cache, $SLAVA_CACHE_DIR; empty: off
+    std::string record_file;    // protocol recording, $SLAVA_RECORD; empty: off
+    std::string replay_file;    // recording played instead of the runner, $SLAVA_REPLAY
+
+    Settings();
+};
+
+extern Settings settings;
+
+#endif
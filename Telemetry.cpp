@@ -0,0 +1,14 @@
+#include "Telemetry.h"
+
+Telemetry telemetry;
+
+Telemetry::Telemetry():
+    nodes(0),
+    tt_probes(0),
+    tt_hits(0),
+    pruned(0),
+    dominated(0),
+    expanded(0),
+    plan_hits(0),
+    plan_misses(0),
+    best_score(0) {}
@@ -0,0 +1,23 @@
+#pragma once
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+// Counters the strategy keeps for debug logs and the benchmark.
+struct Telemetry {
+    long long nodes;        // search nodes visited
+    long long tt_probes;    // transposition table lookups
+    long long tt_hits;      // lookups that cut a subtree
+    long long pruned;       // subtrees cut by their score bound
+    long long dominated;    // states skipped for a dominating one
+    long long expanded;     // search nodes with any child
+    long long plan_hits;    // moves played from a cached plan
+    long long plan_misses;  // cached plans the world broke
+    int best_score;         // of the last move's search
+
+    Telemetry();
+};
+
+extern Telemetry telemetry;
+
+#endif
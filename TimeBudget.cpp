@@ -0,0 +1,49 @@
+#include "TimeBudget.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    double cpu_seconds(clock_t ticks) {
+        return (double) ticks / CLOCKS_PER_SEC;
+    }
+
+    // Every call gets at least this, so the first depth can finish.
+    const double min_allowance = 1e-3;
+}
+
+TimeBudget::TimeBudget():
+    calls(0),
+    first_move(-1),
+    cpu(0),
+    wall(0),
+    last_cpu(0),
+    last_wall(0),
+    cpu_start(0) {}
+
+void TimeBudget::start_move() {
+    cpu_start = clock();
+    wall_start = Clock::now();
+}
+
+void TimeBudget::end_move() {
+    clock_t cpu_end = clock();
+    last_cpu = cpu_seconds(cpu_end - cpu_start);
+    last_wall = chrono::duration< double >(Clock::now() - wall_start).count();
+    cpu = cpu_seconds(cpu_end);
+    wall += last_wall;
+    calls += 1;
+}
+
+double TimeBudget::allowance(double game_time, double reserve,
+        int move_index, int move_count) {
+    if (first_move < 0) {
+        first_move = move_index;
+    }
+    double left = game_time * (1 - reserve) - cpu_seconds(clock());
+    double moves_seen = max(1, move_index - first_move + 1);
+    double calls_per_move = max(1.0, (calls + 1) / moves_seen);
+    int moves_left = max(1, move_count - move_index);
+    return max(min_allowance, left / (moves_left * calls_per_move));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#ifndef _TIME_BUDGET_H_
+#define _TIME_BUDGET_H_
+
+#include <chrono>
+#include <ctime>
+
+// Time the strategy spent over the game and what the next move may take.
+//
+// The CPU time is the whole process's, every thread included, so start-up
+// work like reading the map and building the distance table on its worker
+// and pool threads is charged too, as the game limit charges it.  What is
+// left of the game limit, minus a reserve, is spread over the calls the
+// remaining game moves are expected to make at the rate seen so far.
+struct TimeBudget {
+    typedef std::chrono::steady_clock Clock;
+
+    int calls;              // finished strategy calls
+    int first_move;         // game move of the first call
+    double cpu;             // seconds of the process when the last call ended
+    double wall;            // seconds inside finished calls
+    double last_cpu;        // seconds the last call took
+    double last_wall;
+
+    TimeBudget();
+
+    void start_move();
+    void end_move();
+
+    // Seconds of search for a call in game move move_index of move_count.
+    double allowance(double game_time, double reserve,
+            int move_index, int move_count);
+
+private:
+    std::clock_t cpu_start;
+    Clock::time_point wall_start;
+};
+
+#endif
@@ -0,0 +1,628 @@
+#include "Transport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _LINUX
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const char RECORDING_MAGIC[8] = {'S', 'L', 'A', 'V', 'A', 'R', 'E', 'C'};
+const unsigned int RECORDING_VERSION = 1;
+const int FRAME_HEADER_BYTES = 1 + 4 + 8;
+
+Transport::~Transport() { }
+
+const string UNIX_PREFIX = "unix:";
+const string SHARED_MEMORY_PREFIX = "shm:";
+
+Transport* connectTransport(const string& address, int port) {
+#ifdef _LINUX
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+        UnixSocketTransport* transport = new UnixSocketTransport();
+        if (transport->open(address.substr(UNIX_PREFIX.size()))) {
+            return transport;
+        }
+        delete transport;
+        return NULL;
+    }
+
+    if (address.compare(0, SHARED_MEMORY_PREFIX.size(), SHARED_MEMORY_PREFIX) == 0) {
+        SharedMemoryTransport* transport = new SharedMemoryTransport();
+        if (transport->open(address.substr(SHARED_MEMORY_PREFIX.size()))) {
+            return transport;
+        }
+        delete transport;
+        return NULL;
+    }
+#else
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0
+            || address.compare(0, SHARED_MEMORY_PREFIX.size(), SHARED_MEMORY_PREFIX) == 0) {
+        return NULL;
+    }
+#endif
+
+    SocketTransport* transport = new SocketTransport();
+    if (transport->open(address, port)) {
+        return transport;
+    }
+    delete transport;
+    return NULL;
+}
+
+SocketTransport::SocketTransport() : socket(new CActiveSocket()) { }
+
+SocketTransport::SocketTransport(CActiveSocket* socket) : socket(socket) {
+    socket->DisableNagleAlgoritm();
+}
+
+SocketTransport::~SocketTransport() {
+    delete socket;
+}
+
+bool SocketTransport::open(const string& host, int port) {
+    socket->Initialize();
+    socket->DisableNagleAlgoritm();
+    return socket->Open((const uint8*) host.c_str(), (int16) port);
+}
+
+int SocketTransport::receive(signed char* bytes, int byteCount) {
+    return socket->ReceiveInto((uint8*) bytes, byteCount);
+}
+
+int SocketTransport::send(const signed char* bytes, int byteCount) {
+    return socket->Send((const uint8*) bytes, byteCount);
+}
+
+void SocketTransport::close() {
+    socket->Close();
+}
+
+#ifdef _LINUX
+
+UnixSocketTransport::UnixSocketTransport() : descriptor(-1) { }
+
+UnixSocketTransport::UnixSocketTransport(int descriptor) : descriptor(descriptor) { }
+
+UnixSocketTransport::~UnixSocketTransport() {
+    close();
+}
+
+bool UnixSocketTransport::open(const string& path) {
+    sockaddr_un address;
+    memset(&address, 0, sizeof address);
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof address.sun_path) {
+        return false;
+    }
+    memcpy(address.sun_path, path.c_str(), path.size());
+
+    descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (descriptor < 0 || connect(descriptor, (const sockaddr*) &address, sizeof address) != 0) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+int UnixSocketTransport::receive(signed char* bytes, int byteCount) {
+    ssize_t receivedByteCount;
+    do {
+        receivedByteCount = recv(descriptor, bytes, byteCount, 0);
+    } while (receivedByteCount < 0 && errno == EINTR);
+    return (int) receivedByteCount;
+}
+
+int UnixSocketTransport::send(const signed char* bytes, int byteCount) {
+    ssize_t sentByteCount;
+    do {
+        sentByteCount = ::send(descriptor, bytes, byteCount, MSG_NOSIGNAL);
+    } while (sentByteCount < 0 && errno == EINTR);
+    return (int) sentByteCount;
+}
+
+void UnixSocketTransport::close() {
+    if (descriptor >= 0) {
+        ::close(descriptor);
+        descriptor = -1;
+    }
+}
+
+const char SHARED_MAGIC[8] = {'S', 'L', 'A', 'V', 'A', 'S', 'H', 'M'};
+const unsigned int RING_BYTES = 1 << 18;
+const int SPIN_COUNT = 2000;
+const int WAIT_MILLISECONDS = 100;
+
+// head and tail count all bytes ever written and read.  sequence changes
+// with either of them and is what the other side sleeps on.
+struct SharedRing {
+    atomic<unsigned long long> head;
+    atomic<unsigned long long> tail;
+    atomic<unsigned int> sequence;
+    atomic<unsigned int> sleepers;
+    atomic<unsigned int> closed;
+    char data[RING_BYTES];
+};
+
+// A client takes a listening segment over by switching it to connecting,
+// and switches it to connected once it has filled its pid in.
+enum SharedState {
+    SHARED_LISTENING,
+    SHARED_CONNECTING,
+    SHARED_CONNECTED
+};
+
+struct SharedSegment {
+    char magic[8];
+    atomic<unsigned int> state;
+    atomic<int> serverPid;
+    atomic<int> clientPid;
+    SharedRing toClient;
+    SharedRing toServer;
+};
+
+static void futexWait(atomic<unsigned int>* word, unsigned int value) {
+    timespec timeout = {0, WAIT_MILLISECONDS * 1000000L};
+    syscall(SYS_futex, (unsigned int*) word, FUTEX_WAIT, value, &timeout, NULL, 0);
+}
+
+static void futexWake(atomic<unsigned int>* word) {
+    syscall(SYS_futex, (unsigned int*) word, FUTEX_WAKE, 1 << 30, NULL, NULL, 0);
+}
+
+static bool isAlive(int pid) {
+    return pid > 0 && (kill(pid, 0) == 0 || errno != ESRCH);
+}
+
+static void resetRing(SharedRing& ring) {
+    ring.head = 0;
+    ring.tail = 0;
+    ring.sequence = 0;
+    ring.sleepers = 0;
+    ring.closed = 0;
+}
+
+static void signalRing(SharedRing& ring) {
+    ring.sequence.fetch_add(1);
+    if (ring.sleepers.load() > 0) {
+        futexWake(&ring.sequence);
+    }
+}
+
+// Waits until ready() holds; false once the ring is closed or the peer
+// process is gone.
+template<typename Ready>
+static bool waitRing(SharedRing& ring, const atomic<int>& peerPid, Ready ready) {
+    for (int spin = 0; spin < SPIN_COUNT; ++spin) {
+        if (ready()) {
+            return true;
+        }
+    }
+
+    while (true) {
+        unsigned int sequence = ring.sequence.load();
+        if (ready()) {
+            return true;
+        }
+        if (ring.closed.load() != 0 || !isAlive(peerPid.load())) {
+            return ready();
+        }
+        ring.sleepers.fetch_add(1);
+        if (ring.sequence.load() == sequence) {
+            futexWait(&ring.sequence, sequence);
+        }
+        ring.sleepers.fetch_sub(1);
+    }
+}
+
+SharedMemoryTransport::SharedMemoryTransport()
+: segment(NULL), input(NULL), output(NULL), server(false) { }
+
+SharedMemoryTransport::SharedMemoryTransport(SharedSegment* segment)
+: segment(segment), input(&segment->toServer), output(&segment->toClient), server(true) { }
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+    close();
+}
+
+bool SharedMemoryTransport::open(const string& name) {
+    int descriptor = shm_open(name.c_str(), O_RDWR, 0);
+    if (descriptor < 0) {
+        return false;
+    }
+    void* mapped = mmap(NULL, sizeof(SharedSegment), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+    ::close(descriptor);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+
+    // Waits for the server to accept, as a socket waits in the backlog.
+    segment = (SharedSegment*) mapped;
+    unsigned int state = SHARED_LISTENING;
+    while (!segment->state.compare_exchange_strong(state, SHARED_CONNECTING)) {
+        if (memcmp(segment->magic, SHARED_MAGIC, sizeof segment->magic) != 0
+                || !isAlive(segment->serverPid.load())) {
+            munmap(segment, sizeof(SharedSegment));
+            segment = NULL;
+            return false;
+        }
+        futexWait(&segment->state, state);
+        state = SHARED_LISTENING;
+    }
+    segment->clientPid = getpid();
+    segment->state = SHARED_CONNECTED;
+    futexWake(&segment->state);
+
+    input = &segment->toClient;
+    output = &segment->toServer;
+    return true;
+}
+
+int SharedMemoryTransport::receive(signed char* bytes, int byteCount) {
+    if (segment == NULL) {
+        return -1;
+    }
+    SharedRing& ring = *input;
+    const atomic<int>& peerPid = server ? segment->clientPid : segment->serverPid;
+    unsigned long long tail = ring.tail.load(memory_order_relaxed);
+    if (!waitRing(ring, peerPid, [&]() { return ring.head.load(memory_order_acquire) != tail; })) {
+        return 0;
+    }
+
+    unsigned long long available = ring.head.load(memory_order_acquire) - tail;
+    unsigned int count = (unsigned int) min<unsigned long long>(available, byteCount);
+    unsigned int offset = (unsigned int) (tail % RING_BYTES);
+    unsigned int first = min(count, RING_BYTES - offset);
+    memcpy(bytes, ring.data + offset, first);
+    memcpy(bytes + first, ring.data, count - first);
+    ring.tail.store(tail + count, memory_order_release);
+    signalRing(ring);
+    return (int) count;
+}
+
+int SharedMemoryTransport::send(const signed char* bytes, int byteCount) {
+    if (segment == NULL) {
+        return -1;
+    }
+    SharedRing& ring = *output;
+    const atomic<int>& peerPid = server ? segment->clientPid : segment->serverPid;
+    unsigned long long head = ring.head.load(memory_order_relaxed);
+    if (!waitRing(ring, peerPid,
+            [&]() { return head - ring.tail.load(memory_order_acquire) < RING_BYTES; })
+            || ring.closed.load() != 0) {
+        return -1;
+    }
+
+    unsigned long long space = RING_BYTES - (head - ring.tail.load(memory_order_acquire));
+    unsigned int count = (unsigned int) min<unsigned long long>(space, byteCount);
+    unsigned int offset = (unsigned int) (head % RING_BYTES);
+    unsigned int first = min(count, RING_BYTES - offset);
+    memcpy(ring.data + offset, bytes, first);
+    memcpy(ring.data, bytes + first, count - first);
+    ring.head.store(head + count, memory_order_release);
+    signalRing(ring);
+    return (int) count;
+}
+
+// Closes both directions; the server's segment stays mapped by its
+// listener for the next client.
+void SharedMemoryTransport::close() {
+    if (segment == NULL) {
+        return;
+    }
+    input->closed = 1;
+    output->closed = 1;
+    signalRing(*input);
+    signalRing(*output);
+    if (!server) {
+        munmap(segment, sizeof(SharedSegment));
+    }
+    segment = NULL;
+}
+
+#endif
+
+TransportListener::~TransportListener() { }
+
+class SocketListener : public TransportListener {
+private:
+    CPassiveSocket socket;
+public:
+    bool listen(const string& host, int port) {
+        socket.Initialize();
+        return socket.Listen((const uint8*) host.c_str(), (int16) port);
+    }
+
+    Transport* accept() {
+        CActiveSocket* client = socket.Accept();
+        return client == NULL ? NULL : new SocketTransport(client);
+    }
+};
+
+#ifdef _LINUX
+
+class UnixSocketListener : public TransportListener {
+private:
+    int descriptor;
+    string path;
+public:
+    UnixSocketListener() : descriptor(-1) { }
+
+    ~UnixSocketListener() {
+        if (descriptor >= 0) {
+            ::close(descriptor);
+            unlink(path.c_str());
+        }
+    }
+
+    bool listen(const string& path) {
+        sockaddr_un address;
+        memset(&address, 0, sizeof address);
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof address.sun_path) {
+            return false;
+        }
+        memcpy(address.sun_path, path.c_str(), path.size());
+
+        unlink(path.c_str());
+        descriptor = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (descriptor < 0 || bind(descriptor, (const sockaddr*) &address, sizeof address) != 0
+                || ::listen(descriptor, 1) != 0) {
+            return false;
+        }
+        this->path = path;
+        return true;
+    }
+
+    Transport* accept() {
+        int client;
+        do {
+            client = ::accept(descriptor, NULL, NULL);
+        } while (client < 0 && errno == EINTR);
+        return client < 0 ? NULL : new UnixSocketTransport(client);
+    }
+};
+
+// Owns the segment; every accept() resets it and waits for a client to
+// connect.
+class SharedMemoryListener : public TransportListener {
+private:
+    SharedSegment* segment;
+    string name;
+public:
+    SharedMemoryListener() : segment(NULL) { }
+
+    ~SharedMemoryListener() {
+        if (segment != NULL) {
+            munmap(segment, sizeof(SharedSegment));
+            shm_unlink(name.c_str());
+        }
+    }
+
+    bool listen(const string& name) {
+        shm_unlink(name.c_str());
+        int descriptor = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (descriptor < 0) {
+            return false;
+        }
+        bool sized = ftruncate(descriptor, sizeof(SharedSegment)) == 0;
+        void* mapped = sized
+            ? mmap(NULL, sizeof(SharedSegment), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0)
+            : MAP_FAILED;
+        ::close(descriptor);
+        if (mapped == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            return false;
+        }
+
+        segment = (SharedSegment*) mapped;
+        this->name = name;
+        segment->state = SHARED_CONNECTED;
+        segment->serverPid = getpid();
+        segment->clientPid = 0;
+        memcpy(segment->magic, SHARED_MAGIC, sizeof segment->magic);
+        return true;
+    }
+
+    Transport* accept() {
+        resetRing(segment->toClient);
+        resetRing(segment->toServer);
+        segment->clientPid = 0;
+        segment->state = SHARED_LISTENING;
+        futexWake(&segment->state);
+
+        unsigned int state;
+        while ((state = segment->state.load()) != SHARED_CONNECTED) {
+            futexWait(&segment->state, state);
+        }
+        return new SharedMemoryTransport(segment);
+    }
+};
+
+#endif
+
+TransportListener* TransportListener::listen(const string& address, int port) {
+#ifdef _LINUX
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0) {
+        UnixSocketListener* listener = new UnixSocketListener();
+        if (listener->listen(address.substr(UNIX_PREFIX.size()))) {
+            return listener;
+        }
+        delete listener;
+        return NULL;
+    }
+
+    if (address.compare(0, SHARED_MEMORY_PREFIX.size(), SHARED_MEMORY_PREFIX) == 0) {
+        SharedMemoryListener* listener = new SharedMemoryListener();
+        if (listener->listen(address.substr(SHARED_MEMORY_PREFIX.size()))) {
+            return listener;
+        }
+        delete listener;
+        return NULL;
+    }
+#else
+    if (address.compare(0, UNIX_PREFIX.size(), UNIX_PREFIX) == 0
+            || address.compare(0, SHARED_MEMORY_PREFIX.size(), SHARED_MEMORY_PREFIX) == 0) {
+        return NULL;
+    }
+#endif
+
+    SocketListener* listener = new SocketListener();
+    if (listener->listen(address, port)) {
+        return listener;
+    }
+    delete listener;
+    return NULL;
+}
+
+RecordingTransport::RecordingTransport(Transport* transport, const string& path)
+: transport(transport), file(fopen(path.c_str(), "wb")), start(chrono::steady_clock::now()) {
+    if (file != NULL) {
+        RecordingHeader header;
+        memset(&header, 0, sizeof header);
+        memcpy(header.magic, RECORDING_MAGIC, sizeof header.magic);
+        header.version = RECORDING_VERSION;
+        fwrite(&header, sizeof header, 1, file);
+    }
+}
+
+RecordingTransport::~RecordingTransport() {
+    if (file != NULL) {
+        fclose(file);
+    }
+    delete transport;
+}
+
+bool RecordingTransport::isOpen() const {
+    return file != NULL;
+}
+
+void RecordingTransport::writeFrame(char direction, const signed char* bytes, int byteCount) {
+    if (file == NULL || byteCount <= 0) {
+        return;
+    }
+
+    long long microseconds = chrono::duration_cast<chrono::microseconds>(
+            chrono::steady_clock::now() - start).count();
+    char header[FRAME_HEADER_BYTES];
+    header[0] = direction;
+    memcpy(header + 1, &byteCount, 4);
+    memcpy(header + 5, &microseconds, 8);
+    fwrite(header, sizeof header, 1, file);
+    fwrite(bytes, 1, byteCount, file);
+}
+
+int RecordingTransport::receive(signed char* bytes, int byteCount) {
+    int receivedByteCount = transport->receive(bytes, byteCount);
+    writeFrame('R', bytes, receivedByteCount);
+    return receivedByteCount;
+}
+
+// A sent message ends a move, so the recording is flushed for a crash to
+// keep everything up to it.
+int RecordingTransport::send(const signed char* bytes, int byteCount) {
+    int sentByteCount = transport->send(bytes, byteCount);
+    writeFrame('S', bytes, sentByteCount);
+    if (file != NULL) {
+        fflush(file);
+    }
+    return sentByteCount;
+}
+
+void RecordingTransport::close() {
+    transport->close();
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+RecordingReader::RecordingReader() : file(NULL) { }
+
+RecordingReader::~RecordingReader() {
+    close();
+}
+
+bool RecordingReader::open(const string& path) {
+    close();
+    file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    RecordingHeader header;
+    if (fread(&header, sizeof header, 1, file) != 1
+            || memcmp(header.magic, RECORDING_MAGIC, sizeof header.magic) != 0
+            || header.version != RECORDING_VERSION) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool RecordingReader::next(RecordingFrame& frame, string& bytes) {
+    char header[FRAME_HEADER_BYTES];
+    if (file == NULL || fread(header, sizeof header, 1, file) != 1) {
+        return false;
+    }
+
+    frame.direction = header[0];
+    memcpy(&frame.byteCount, header + 1, 4);
+    memcpy(&frame.microseconds, header + 5, 8);
+    if (frame.byteCount < 0) {
+        return false;
+    }
+
+    bytes.resize(frame.byteCount);
+    return frame.byteCount == 0 || fread(&bytes[0], frame.byteCount, 1, file) == 1;
+}
+
+void RecordingReader::close() {
+    if (file != NULL) {
+        fclose(file);
+        file = NULL;
+    }
+}
+
+ReplayTransport::ReplayTransport() : pendingOffset(0) { }
+
+bool ReplayTransport::open(const string& path) {
+    pending.clear();
+    pendingOffset = 0;
+    return reader.open(path);
+}
+
+int ReplayTransport::receive(signed char* bytes, int byteCount) {
+    RecordingFrame frame;
+    while (pendingOffset == pending.size()) {
+        if (!reader.next(frame, pending)) {
+            return 0;
+        }
+        pendingOffset = frame.direction == 'R' ? 0 : pending.size();
+    }
+
+    int copiedByteCount = (int) min((size_t) byteCount, pending.size() - pendingOffset);
+    memcpy(bytes, pending.data() + pendingOffset, copiedByteCount);
+    pendingOffset += copiedByteCount;
+    return copiedByteCount;
+}
+
+int ReplayTransport::send(const signed char*, int byteCount) {
+    return byteCount;
+}
+
+void ReplayTransport::close() {
+    reader.close();
+}
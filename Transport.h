@@ -0,0 +1,177 @@
+#pragma once
+
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "csimplesocket/ActiveSocket.h"
+#include "csimplesocket/PassiveSocket.h"
+
+// The byte stream between RemoteProcessClient and the runner.
+class Transport {
+public:
+    virtual ~Transport();
+
+    // Up to byteCount bytes into bytes, as many as are available but at
+    // least one; 0 or less at the end of the stream.
+    virtual int receive(signed char* bytes, int byteCount) = 0;
+    // Some of byteCount bytes, 0 or less on failure.
+    virtual int send(const signed char* bytes, int byteCount) = 0;
+    virtual void close() = 0;
+};
+
+// Connects to address: "unix:<path>" for a Unix domain socket,
+// "shm:<name>" for a shared memory segment, otherwise a TCP host.  NULL
+// when nobody listens there; the first two are only built with _LINUX,
+// elsewhere only TCP connects.
+Transport* connectTransport(const std::string& address, int port);
+
+// The other end of connectTransport(), for stand-in servers.
+class TransportListener {
+public:
+    virtual ~TransportListener();
+
+    // The next client, NULL on failure.
+    virtual Transport* accept() = 0;
+
+    // Listens on address as connectTransport() reads it, TCP on the
+    // given host and port.  NULL on failure.
+    static TransportListener* listen(const std::string& address, int port);
+};
+
+class SocketTransport : public Transport {
+private:
+    CActiveSocket* socket;
+public:
+    SocketTransport();
+    // Takes ownership of an accepted socket.
+    SocketTransport(CActiveSocket* socket);
+    ~SocketTransport();
+
+    bool open(const std::string& host, int port);
+
+    int receive(signed char* bytes, int byteCount);
+    int send(const signed char* bytes, int byteCount);
+    void close();
+};
+
+#ifdef _LINUX
+
+class UnixSocketTransport : public Transport {
+private:
+    int descriptor;
+public:
+    UnixSocketTransport();
+    // Takes ownership of a connected descriptor.
+    UnixSocketTransport(int descriptor);
+    ~UnixSocketTransport();
+
+    bool open(const std::string& path);
+
+    int receive(signed char* bytes, int byteCount);
+    int send(const signed char* bytes, int byteCount);
+    void close();
+};
+
+struct SharedSegment;
+struct SharedRing;
+
+// Two single-producer single-consumer byte rings in a POSIX shared memory
+// segment, one per direction.  Whoever waits spins briefly and then
+// sleeps on a futex, which the other side only wakes when someone sleeps.
+class SharedMemoryTransport : public Transport {
+private:
+    SharedSegment* segment;
+    SharedRing* input;
+    SharedRing* output;
+    bool server;
+public:
+    SharedMemoryTransport();
+    // The server's end of a segment it created.
+    SharedMemoryTransport(SharedSegment* segment);
+    ~SharedMemoryTransport();
+
+    bool open(const std::string& name);
+
+    int receive(signed char* bytes, int byteCount);
+    int send(const signed char* bytes, int byteCount);
+    void close();
+};
+
+#endif
+
+// Recordings are a header and a sequence of frames, one per receive() or
+// send() call that moved data:
+//
+//     RecordingHeader
+//     direction (1 byte, 'R' received or 'S' sent), byte count (4 bytes),
+//     microseconds since the recording started (8 bytes), the bytes
+//
+// all little-endian.
+struct RecordingHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int reserved;
+};
+
+struct RecordingFrame {
+    char direction;
+    int byteCount;
+    long long microseconds;
+};
+
+// Writes everything that passes through another transport to a file.
+class RecordingTransport : public Transport {
+private:
+    Transport* transport;
+    FILE* file;
+    std::chrono::steady_clock::time_point start;
+
+    void writeFrame(char direction, const signed char* bytes, int byteCount);
+public:
+    // Takes ownership of transport.
+    RecordingTransport(Transport* transport, const std::string& path);
+    ~RecordingTransport();
+
+    bool isOpen() const;
+
+    int receive(signed char* bytes, int byteCount);
+    int send(const signed char* bytes, int byteCount);
+    void close();
+};
+
+// Reads a recording frame by frame.
+class RecordingReader {
+private:
+    FILE* file;
+public:
+    RecordingReader();
+    ~RecordingReader();
+
+    bool open(const std::string& path);
+    // The next frame and its bytes, false at the end of the recording.
+    bool next(RecordingFrame& frame, std::string& bytes);
+    void close();
+};
+
+// Plays the received side of a recording back; whatever is sent is
+// dropped, so a changed strategy still runs to the end.
+class ReplayTransport : public Transport {
+private:
+    RecordingReader reader;
+    std::string pending;
+    size_t pendingOffset;
+public:
+    ReplayTransport();
+
+    bool open(const std::string& path);
+
+    int receive(signed char* bytes, int byteCount);
+    int send(const signed char* bytes, int byteCount);
+    void close();
+};
+
+#endif
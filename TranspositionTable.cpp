@@ -0,0 +1,88 @@
+#include "TranspositionTable.h"
+
+#include "Telemetry.h"
+
+using namespace std;
+
+namespace {
+    // splitmix64: the strategy's rand() sequence must stay untouched.
+    unsigned long long mix(unsigned long long x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    }
+}
+
+TranspositionTable::TranspositionTable():
+    mask(0),
+    stances(0),
+    generation(0),
+    used(0) {}
+
+void TranspositionTable::init(int cells, int stances, int flags, int bits) {
+    Entry empty = {0, -1, 0, 0};
+    entries.assign(2ULL << bits, empty);
+    mask = (1ULL << bits) - 1;
+    this->stances = stances;
+    generation = 0;
+    used = 0;
+
+    unsigned long long seed = 0;
+    cell_keys.resize(cells * stances);
+    for (auto& key : cell_keys) {
+        key = mix(seed += 1);
+    }
+    flag_keys.resize(1 << flags);
+    for (auto& key : flag_keys) {
+        key = mix(seed += 1);
+    }
+}
+
+void TranspositionTable::reset() {
+    generation += 1;
+    used = 0;
+}
+
+unsigned long long TranspositionTable::key(int cell, int stance, int flags,
+        int action_points, int damage, int mate_damage, int kills) const {
+    unsigned long long counters =
+        ((unsigned long long) (unsigned short) action_points << 48) |
+        ((unsigned long long) (unsigned short) damage << 32) |
+        ((unsigned long long) (unsigned short) mate_damage << 16) |
+        (unsigned short) kills;
+    return cell_keys[cell * stances + stance] ^ flag_keys[flags] ^ mix(counters);
+}
+
+void TranspositionTable::put(Entry& slot, const Entry& entry) {
+    if (slot.generation != generation) {
+        used += 1;
+    }
+    slot = entry;
+}
+
+bool TranspositionTable::visit(unsigned long long key, int depth, int order) {
+    telemetry.tt_probes += 1;
+    Entry& deep = entries[(key & mask) * 2];
+    Entry& recent = entries[(key & mask) * 2 + 1];
+
+    for (Entry* e : {&deep, &recent}) {
+        if (e->generation == generation && e->key == key && e->depth >= depth &&
+                e->order <= order) {
+            telemetry.tt_hits += 1;
+            return true;
+        }
+    }
+
+    Entry entry = {key, depth, order, generation};
+    if (deep.generation != generation || deep.depth <= depth) {
+        if (deep.generation == generation && deep.key != key) {
+            put(recent, deep);
+        }
+        put(deep, entry);
+    }
+    else {
+        put(recent, entry);
+    }
+    return false;
+}
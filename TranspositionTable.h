@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef _TRANSPOSITION_TABLE_H_
+#define _TRANSPOSITION_TABLE_H_
+
+#include <vector>
+
+// Search states already expanded during the current move, keyed by a
+// Zobrist hash of the state.
+//
+// The table has a fixed number of two-entry buckets: the first entry keeps
+// the state with the most actions left below it, the second one always
+// takes the newest state.  Entries of earlier moves are told apart by a
+// generation number, so reset() does not touch the table.
+struct TranspositionTable {
+    struct Entry {
+        unsigned long long key;
+        int depth;              // actions left below the state
+        int order;              // lowest action rank that could follow
+        unsigned generation;
+    };
+
+    std::vector< Entry > entries;
+    unsigned long long mask;    // buckets - 1
+    int stances;
+    unsigned generation;
+    int used;                   // entries of the current generation
+
+    std::vector< unsigned long long > cell_keys;    // per (cell, stance)
+    std::vector< unsigned long long > flag_keys;    // per item flags
+
+    TranspositionTable();
+
+    bool enabled() const {
+        return !entries.empty();
+    }
+
+    int size() const {
+        return entries.size();
+    }
+
+    // 2^bits buckets, cells * stances position keys.
+    void init(int cells, int stances, int flags, int bits);
+
+    void reset();
+
+    unsigned long long key(int cell, int stance, int flags, int action_points,
+            int damage, int mate_damage, int kills) const;
+
+    // True when the state was already expanded with at least depth actions
+    // left and no later place in the canonical action order, so with all
+    // the actions that follow it now.  Otherwise remembers it and returns
+    // false.
+    bool visit(unsigned long long key, int depth, int order);
+
+private:
+    void put(Entry& slot, const Entry& entry);
+};
+
+#endif
@@ -820,6 +820,101 @@ int32 CSimpleSocket::Receive(int32 nMaxBytes)
 }
 
 
+//------------------------------------------------------------------------------
+//
+// ReceiveInto() - Attempts to receive a block of data on an established
+//                 connection into a buffer owned by the caller.  The internal
+//                 buffer is not touched.
+//
+//------------------------------------------------------------------------------
+int32 CSimpleSocket::ReceiveInto(uint8 *pBuf, size_t nMaxBytes)
+{
+    m_nBytesReceived = 0;
+
+    //--------------------------------------------------------------------------
+    // If the socket is invalid then return false.
+    //--------------------------------------------------------------------------
+    if ((IsSocketValid() == false) || (pBuf == NULL) || (nMaxBytes == 0))
+    {
+        return m_nBytesReceived;
+    }
+
+    SetSocketError(SocketSuccess);
+
+    m_timer.Initialize();
+    m_timer.SetStartTime();
+
+    switch (m_nSocketType)
+    {
+        case CSimpleSocket::SocketTypeTcp:
+        {
+            do
+            {
+                m_nBytesReceived = RECV(m_socket, pBuf, nMaxBytes, m_nFlags);
+                TranslateSocketError();
+            } while ((GetSocketError() == CSimpleSocket::SocketInterrupted));
+
+            break;
+        }
+        case CSimpleSocket::SocketTypeUdp:
+        {
+            uint32 srcSize;
+            struct sockaddr_in *pSource;
+
+            srcSize = sizeof(struct sockaddr_in);
+            pSource = GetMulticast() ? &m_stMulticastGroup : &m_stClientSockaddr;
+
+            do
+            {
+                m_nBytesReceived = RECVFROM(m_socket, pBuf, nMaxBytes, 0,
+                                            pSource, &srcSize);
+                TranslateSocketError();
+            } while (GetSocketError() == CSimpleSocket::SocketInterrupted);
+
+            break;
+        }
+        default:
+            break;
+    }
+
+    m_timer.SetEndTime();
+    TranslateSocketError();
+
+    return m_nBytesReceived;
+}
+
+
+//------------------------------------------------------------------------------
+//
+// ReceiveAll() - Receives exactly nBytes into a buffer owned by the caller,
+//                unless the connection is shutdown or fails first.
+//
+//------------------------------------------------------------------------------
+int32 CSimpleSocket::ReceiveAll(uint8 *pBuf, size_t nBytes)
+{
+    size_t nTotal = 0;
+
+    while (nTotal < nBytes)
+    {
+        int32 nReceived = ReceiveInto(pBuf + nTotal, nBytes - nTotal);
+
+        if (nReceived == CSimpleSocket::SocketError)
+        {
+            return CSimpleSocket::SocketError;
+        }
+
+        if (nReceived == 0)
+        {
+            break;
+        }
+
+        nTotal += nReceived;
+    }
+
+    return (int32)nTotal;
+}
+
+
 //------------------------------------------------------------------------------
 //
 // SetNonblocking()
@@ -206,6 +206,27 @@ public:
     /// @return of -1 means that an error has occurred.
     virtual int32 Receive(int32 nMaxBytes = 1);
 
+    /// Attempts to receive a block of data on an established connection into
+    /// memory owned by the caller.  Unlike CSimpleSocket::Receive, the
+    /// internal buffer is neither allocated nor freed, so GetData() is left
+    /// as it was.
+    /// @param pBuf buffer to receive into.
+    /// @param nMaxBytes maximum number of bytes to receive, at most the size of pBuf.
+    /// @return number of bytes actually received.
+    /// @return of zero means the connection has been shutdown on the other side.
+    /// @return of -1 means that an error has occurred.
+    virtual int32 ReceiveInto(uint8 *pBuf, size_t nMaxBytes);
+
+    /// Receives exactly nBytes into memory owned by the caller, calling
+    /// CSimpleSocket::ReceiveInto until they are all there.
+    /// @param pBuf buffer to receive into.
+    /// @param nBytes number of bytes to receive, at most the size of pBuf.
+    /// @return nBytes on success.
+    /// @return of fewer bytes means the connection was shutdown on the other
+    /// side first; GetBytesReceived() holds the bytes of the last call only.
+    /// @return of -1 means that an error has occurred.
+    virtual int32 ReceiveAll(uint8 *pBuf, size_t nBytes);
+
     /// Attempts to send a block of data on an established connection.
     /// @param pBuf block of data to be sent.
     /// @param bytesToSend size of data block to be sent.
@@ -5,6 +5,8 @@ use strict;
 
 $\ = "\n";
 
+$ENV{SLAVA_CACHE_DIR} //= 'cache';
+
 my $runner;
 unless ($runner = fork) {
     `java -cp ".:*" -jar local-runner.jar run-once.properties`;
@@ -1,17 +1,19 @@
 #include "Player.h"
 
+#include <utility>
+
 using namespace model;
 using namespace std;
 
 Player::Player(long long id, string name, int score, bool strategyCrashed, int approximateX, int approximateY)
-: id(id), name(name), score(score), strategyCrashed(strategyCrashed),
+: id(id), name(std::move(name)), score(score), strategyCrashed(strategyCrashed),
 approximateX(approximateX), approximateY(approximateY) { }
 
 long long Player::getId() const {
     return id;
 }
 
-string Player::getName() const {
+const string& Player::getName() const {
     return name;
 }
 
@@ -18,7 +18,7 @@ namespace model {
         Player(long long id, std::string name, int score, bool strategyCrashed, int approximateX, int approximateY);
 
         long long getId() const;
-        std::string getName() const;
+        const std::string& getName() const;
         int getScore() const;
         bool isStrategyCrashed() const;
         int getApproximateX() const;
@@ -1,9 +1,11 @@
 #include "PlayerContext.h"
 
+#include <utility>
+
 using namespace model;
 
 PlayerContext::PlayerContext(Trooper trooper, World world)
-: trooper(trooper), world(world) { }
+: trooper(std::move(trooper)), world(std::move(world)) { }
 
 const Trooper& PlayerContext::getTrooper() const {
     return trooper;
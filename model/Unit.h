@@ -12,8 +12,13 @@ namespace model {
     protected:
         Unit(long long id, int x, int y);
     public:
+        Unit(const Unit& unit) = default;
+        Unit(Unit&& unit) = default;
         virtual ~Unit();
 
+        Unit& operator=(const Unit& unit) = default;
+        Unit& operator=(Unit&& unit) = default;
+
         long long getId() const;
         int getX() const;
         int getY() const;
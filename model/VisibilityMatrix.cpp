@@ -0,0 +1,111 @@
+#include "VisibilityMatrix.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+
+using namespace model;
+using namespace std;
+
+VisibilityMatrix::VisibilityMatrix()
+: width(0), height(0), stanceCount(0), rowWords(0), viewerStride(0), words(NULL) { }
+
+VisibilityMatrix::VisibilityMatrix(int width, int height, int stanceCount)
+: width(width), height(height), stanceCount(stanceCount),
+rowWords((width * height + 63) / 64), viewerStride(height * stanceCount * rowWords),
+storage((size_t) width * viewerStride, 0), words(storage.empty() ? NULL : &storage[0]) { }
+
+VisibilityMatrix::VisibilityMatrix(const VisibilityMatrix& matrix)
+: width(matrix.width), height(matrix.height), stanceCount(matrix.stanceCount),
+rowWords(matrix.rowWords), viewerStride(matrix.viewerStride), storage(matrix.storage),
+words(storage.empty() ? matrix.words : &storage[0]) { }
+
+// A moved vector keeps its buffer, so words stay valid.
+VisibilityMatrix::VisibilityMatrix(VisibilityMatrix&& matrix)
+: width(matrix.width), height(matrix.height), stanceCount(matrix.stanceCount),
+rowWords(matrix.rowWords), viewerStride(matrix.viewerStride), storage(std::move(matrix.storage)),
+words(matrix.words) {
+    matrix.words = NULL;
+}
+
+VisibilityMatrix& VisibilityMatrix::operator=(const VisibilityMatrix& matrix) {
+    if (this != &matrix) {
+        width = matrix.width;
+        height = matrix.height;
+        stanceCount = matrix.stanceCount;
+        rowWords = matrix.rowWords;
+        viewerStride = matrix.viewerStride;
+        storage = matrix.storage;
+        words = storage.empty() ? matrix.words : &storage[0];
+    }
+    return *this;
+}
+
+VisibilityMatrix& VisibilityMatrix::operator=(VisibilityMatrix&& matrix) {
+    if (this != &matrix) {
+        width = matrix.width;
+        height = matrix.height;
+        stanceCount = matrix.stanceCount;
+        rowWords = matrix.rowWords;
+        viewerStride = matrix.viewerStride;
+        storage = std::move(matrix.storage);
+        words = matrix.words;
+        matrix.words = NULL;
+    }
+    return *this;
+}
+
+int VisibilityMatrix::getWidth() const {
+    return width;
+}
+
+int VisibilityMatrix::getHeight() const {
+    return height;
+}
+
+int VisibilityMatrix::getStanceCount() const {
+    return stanceCount;
+}
+
+int VisibilityMatrix::getRowWords() const {
+    return rowWords;
+}
+
+int VisibilityMatrix::getWordCount() const {
+    return width * viewerStride;
+}
+
+int VisibilityMatrix::getWordCount(int width, int height, int stanceCount) {
+    return width * height * stanceCount * ((width * height + 63) / 64);
+}
+
+const unsigned long long* VisibilityMatrix::getWords() const {
+    return words;
+}
+
+void VisibilityMatrix::attach(const unsigned long long* words) {
+    vector<unsigned long long>().swap(storage);
+    this->words = words;
+}
+
+void VisibilityMatrix::set(int viewerX, int viewerY, int objectX, int objectY, int stance) {
+    int bit = objectX * height + objectY;
+    storage[getRowIndex(viewerX, viewerY, stance) + (bit >> 6)] |= 1ULL << (bit & 63);
+}
+
+void VisibilityMatrix::setViewer(int viewerX, int viewerY, const signed char* visibilities) {
+    int cellCount = width * height;
+    for (int stance = 0; stance < stanceCount; ++stance) {
+        unsigned long long* row = &storage[getRowIndex(viewerX, viewerY, stance)];
+        for (int word = 0; word < rowWords; ++word) {
+            int first = word * 64;
+            int last = min(first + 64, cellCount);
+            unsigned long long bits = 0;
+            for (int cell = first; cell < last; ++cell) {
+                bits |= (unsigned long long) (visibilities[cell * stanceCount + stance] != 0)
+                        << (cell - first);
+            }
+            row[word] = bits;
+        }
+    }
+}
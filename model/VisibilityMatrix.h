@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef _VISIBILITY_MATRIX_H_
+#define _VISIBILITY_MATRIX_H_
+
+#include <vector>
+
+namespace model {
+    // Cell-to-cell visibility packed into bits.
+    //
+    // Every (viewerX, viewerY, stance) owns a row of getRowWords() 64-bit
+    // words with one bit per object cell, at bit objectX * height + objectY.
+    // Rows can be combined with plain word-wise AND and OR.
+    class VisibilityMatrix {
+    private:
+        int width;
+        int height;
+        int stanceCount;
+        int rowWords;
+        int viewerStride;
+        std::vector<unsigned long long> storage;
+        const unsigned long long* words;    // into storage unless attached
+    public:
+        VisibilityMatrix();
+        VisibilityMatrix(int width, int height, int stanceCount);
+        // Copies own their words; attached ones share the attached words.
+        VisibilityMatrix(const VisibilityMatrix& matrix);
+        VisibilityMatrix(VisibilityMatrix&& matrix);
+        VisibilityMatrix& operator=(const VisibilityMatrix& matrix);
+        VisibilityMatrix& operator=(VisibilityMatrix&& matrix);
+
+        int getWidth() const;
+        int getHeight() const;
+        int getStanceCount() const;
+        int getRowWords() const;
+        int getWordCount() const;
+        static int getWordCount(int width, int height, int stanceCount);
+        const unsigned long long* getWords() const;
+
+        // Uses words stored elsewhere, e.g. mapped from the map cache.
+        void attach(const unsigned long long* words);
+
+        void set(int viewerX, int viewerY, int objectX, int objectY, int stance);
+
+        // Packs the runner's bytes for one viewer: one per object cell and
+        // stance, stance varying fastest.
+        void setViewer(int viewerX, int viewerY, const signed char* visibilities);
+
+        int getRowIndex(int viewerX, int viewerY, int stance) const {
+            return viewerX * viewerStride + (viewerY * stanceCount + stance) * rowWords;
+        }
+
+        const unsigned long long* getRow(int viewerX, int viewerY, int stance) const {
+            return words + getRowIndex(viewerX, viewerY, stance);
+        }
+
+        bool isVisible(int viewerX, int viewerY, int objectX, int objectY, int stance) const {
+            int bit = objectX * height + objectY;
+            return (getRow(viewerX, viewerY, stance)[bit >> 6] >> (bit & 63)) & 1;
+        }
+    };
+}
+
+#endif
@@ -3,6 +3,7 @@
 #define _USE_MATH_DEFINES
 #include <algorithm>
 #include <cmath>
+#include <utility>
 
 using namespace model;
 using namespace std;
@@ -10,9 +11,9 @@ using namespace std;
 World::World(int moveIndex, int width, int height, vector<Player> players,
              vector<Trooper> troopers, vector<Bonus> bonuses,
              const vector<vector<CellType> >& cells,
-             const vector<bool>& cellVisibilities)
-             : moveIndex(moveIndex), width(width), height(height), players(players),
-             troopers(troopers), bonuses(bonuses), cells(&cells), cellVisibilities(&cellVisibilities) { }
+             const VisibilityMatrix& cellVisibilities)
+             : moveIndex(moveIndex), width(width), height(height), players(std::move(players)),
+             troopers(std::move(troopers)), bonuses(std::move(bonuses)), cells(&cells), cellVisibilities(&cellVisibilities) { }
 
 int World::getMoveIndex() const {
     return moveIndex;
@@ -42,7 +43,7 @@ const vector<vector<CellType> >& World::getCells() const {
     return *cells;
 }
 
-const vector<bool>& World::getCellVisibilities() const {
+const VisibilityMatrix& World::getCellVisibilities() const {
     return *cellVisibilities;
 }
 
@@ -54,11 +55,5 @@ bool World::isVisible(double maxRange,
     int yRange = objectY - viewerY;
     
     return xRange * xRange + yRange * yRange <= maxRange * maxRange
-        && (*cellVisibilities)[
-            viewerX * height * width * height * _TROOPER_STANCE_COUNT_
-                + viewerY * width * height * _TROOPER_STANCE_COUNT_
-                + objectX * height * _TROOPER_STANCE_COUNT_
-                + objectY * _TROOPER_STANCE_COUNT_
-                + minStanceIndex
-        ];
+        && cellVisibilities->isVisible(viewerX, viewerY, objectX, objectY, minStanceIndex);
 }
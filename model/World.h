@@ -8,6 +8,7 @@
 #include "Bonus.h"
 #include "Player.h"
 #include "Trooper.h"
+#include "VisibilityMatrix.h"
 
 namespace model {
     enum CellType {
@@ -18,6 +19,9 @@ namespace model {
         HIGH_COVER = 3
     };
 
+    // Takes players, troopers and bonuses by value: pass them with
+    // std::move to hand them over without a copy.  Cells and visibilities
+    // are only referenced.
     class World {
     private:
         int moveIndex;
@@ -27,12 +31,12 @@ namespace model {
         std::vector<Trooper> troopers;
         std::vector<Bonus> bonuses;
         const std::vector<std::vector<CellType> >* cells;
-        const std::vector<bool>* cellVisibilities;
+        const VisibilityMatrix* cellVisibilities;
     public:
         World(int moveIndex, int width, int height, std::vector<Player> players,
             std::vector<Trooper> troopers, std::vector<Bonus> bonuses,
             const std::vector<std::vector<CellType> >& cells,
-            const std::vector<bool>& cellVisibilities);
+            const VisibilityMatrix& cellVisibilities);
 
         int getMoveIndex() const;
         int getWidth() const;
@@ -41,7 +45,7 @@ namespace model {
         const std::vector<Trooper>& getTroopers() const;
         const std::vector<Bonus>& getBonuses() const;
         const std::vector<std::vector<CellType> >& getCells() const;
-        const std::vector<bool>& getCellVisibilities() const;
+        const VisibilityMatrix& getCellVisibilities() const;
         bool isVisible(double maxRange,
             int viewerX, int viewerY, TrooperStance viewerStance,
             int objectX, int objectY, TrooperStance objectStance) const;
@@ -0,0 +1,751 @@
+#include "Encoder.h"
+#include "Measure.h"
+#include "Scenario.h"
+
+#include "../DistanceTable.h"
+#include "../MapCache.h"
+#include "../MyStrategy.h"
+#include "../RemoteProcessClient.h"
+#include "../Settings.h"
+#include "../Telemetry.h"
+#include "../Transport.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace model;
+using namespace std;
+
+// Every heap allocation in the process, for the replay's per-move counts.
+atomic< long long > allocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, memory_order_relaxed);
+    void* memory = malloc(size == 0 ? 1 : size);
+    if (memory == NULL) {
+        throw bad_alloc();
+    }
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+int bench_distances(const vector< Map >& maps) {
+    int threads = max(1, (int) thread::hardware_concurrency());
+    char cache_dir[] = "/tmp/slava-bench-XXXXXX";
+    if (mkdtemp(cache_dir) == NULL) {
+        cerr << "cannot create " << cache_dir << endl;
+        return 2;
+    }
+
+    printf("%-24s %6s %12s %12s %10s %14s %12s %s\n",
+            "map", "cells", "floyd, ms", "bfs, ms", "speedup", "bfs x threads",
+            "mapped, ms", "same");
+    bool all_same = true;
+    for (auto& map : maps) {
+        DistanceTable floyd;
+        auto start = chrono::steady_clock::now();
+        floyd.build_floyd(map.cells);
+        double floyd_time = seconds_since(start);
+
+        DistanceTable bfs;
+        start = chrono::steady_clock::now();
+        bfs.build_bfs(map.cells);
+        double bfs_time = seconds_since(start);
+
+        DistanceTable parallel;
+        start = chrono::steady_clock::now();
+        parallel.build_bfs(map.cells, threads);
+        double parallel_time = seconds_since(start);
+
+        LazyDistances lazy;
+        lazy.init(map.cells, 16);
+        bool lazy_same = true;
+        for (int b = 0; b < bfs.size; b += 1) {
+            for (int a = 0; a < bfs.size; a += 1) {
+                unsigned short d = lazy.row(b)[a];
+                lazy_same = lazy_same && (d == 0xFFFF ? DistanceTable::inf : d) == bfs.get(a, b);
+            }
+        }
+
+        MapCache::save(cache_dir, map.cells, bfs, VisibilityMatrix());
+        MapCache cache;
+        DistanceTable mapped;
+        start = chrono::steady_clock::now();
+        bool cached = cache.open(cache_dir, map.cells);
+        if (cached) {
+            mapped.attach(map.cells, cache.distance_rows(),
+                    cache.header().distance_stride, cache.header().distance_wide);
+        }
+        double mapped_time = seconds_since(start);
+
+        bool same = floyd == bfs && lazy_same && bfs.wide == parallel.wide &&
+            memcmp(bfs.data, parallel.data, bfs.bytes()) == 0 &&
+            cached && mapped == bfs;
+        all_same = all_same && same;
+        char parallel_column[32];
+        snprintf(parallel_column, sizeof parallel_column, "%.3f x %d", 1000 * parallel_time, threads);
+        printf("%-24s %6d %12.3f %12.3f %9.1fx %14s %12.3f %s\n",
+                map.name.c_str(), bfs.size, 1000 * floyd_time, 1000 * bfs_time,
+                floyd_time / bfs_time, parallel_column, 1000 * mapped_time,
+                same ? "yes" : "NO");
+        unlink(MapCache::path(cache_dir, MapCache::hash(map.cells)).c_str());
+    }
+    rmdir(cache_dir);
+    return all_same ? 0 : 1;
+}
+
+struct SearchResult {
+    long long moves;
+    long long nodes;
+    long long pruned;               // subtrees cut by score bounds
+    long long expanded;             // nodes with any child
+    double seconds;
+    unsigned long long actions;     // hash of the chosen actions
+    unsigned long long scores;      // hash of their scores
+};
+
+// Runs MyStrategy on shuffled scenarios of one map.  The first move also
+// pays for the strategy start-up and is left out.
+SearchResult search_pass(const Map& map, int moves, vector< int >* scores = NULL) {
+    Scenario scenario(map.cells);
+    Game game = stock_game();
+    MyStrategy strategy;
+    SearchResult result = {0, 0, 0, 0, 0, 14695981039346656037ULL, 14695981039346656037ULL};
+
+    for (int move_index = 0; move_index <= moves; move_index += 1) {
+        scenario.shuffle(move_index);
+        World world = scenario.world(move_index);
+        const Trooper& self = scenario.troopers[move_index % 5];
+        Move move;
+
+        long long nodes = telemetry.nodes;
+        long long pruned = telemetry.pruned;
+        long long expanded = telemetry.expanded;
+        auto start = chrono::steady_clock::now();
+        strategy.move(self, world, game, move);
+        double seconds = seconds_since(start);
+        if (move_index == 0) {
+            continue;
+        }
+
+        result.moves += 1;
+        result.nodes += telemetry.nodes - nodes;
+        result.pruned += telemetry.pruned - pruned;
+        result.expanded += telemetry.expanded - expanded;
+        result.seconds += seconds;
+        result.actions = (result.actions ^ move.getAction()) * 1099511628211ULL;
+        result.actions = (result.actions ^ (move.getX() * 64 + move.getY())) * 1099511628211ULL;
+        result.scores = (result.scores ^ (unsigned) telemetry.best_score) * 1099511628211ULL;
+        if (scores != NULL) {
+            scores->push_back(telemetry.best_score);
+        }
+    }
+    return result;
+}
+
+typedef void (*Configure)();
+
+// Strategy state is global, so every configuration gets a fresh process.
+SearchResult search_in_child(const Map& map, int moves, Configure configure) {
+    SearchResult result = {0, 0, 0, 0, 0, 0, 0};
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return result;
+    }
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        configure();
+        result = search_pass(map, moves);
+        ssize_t written = write(fds[1], &result, sizeof result);
+        _exit(written == sizeof result ? 0 : 1);
+    }
+    close(fds[1]);
+    if (read(fds[0], &result, sizeof result) != sizeof result) {
+        result.moves = 0;
+    }
+    close(fds[0]);
+    waitpid(child, NULL, 0);
+    return result;
+}
+
+// Branching is nodes per node with any child, roots included.
+void print_search(const char* name, const SearchResult& result) {
+    printf("%-20s %6lld moves %12lld nodes %10lld pruned %6.2f branching %10.3f s %12.0f nodes/s %10.3f ms/move\n",
+            name, result.moves, result.nodes, result.pruned,
+            result.nodes / (double) max(result.expanded, 1LL), result.seconds,
+            result.nodes / max(result.seconds, 1e-9),
+            1000 * result.seconds / max(result.moves, 1LL));
+}
+
+// Every configuration changes one more thing on top of the previous one.
+int bench_search(const Map& map, int moves) {
+    printf("map %s, %d moves\n", map.name.c_str(), moves);
+
+    struct {
+        const char* name;
+        Configure configure;
+    } passes[] = {
+        {"isVisible per leaf", []() {
+            settings.game_time = 0;
+            settings.threat_map = false;
+            settings.transposition_bits = 0;
+            settings.branch_and_bound = false;
+            settings.dominance_bits = 0;
+            settings.canonical_order = false;
+        }},
+        {"threat map", []() {
+            settings.game_time = 0;
+            settings.transposition_bits = 0;
+            settings.branch_and_bound = false;
+            settings.dominance_bits = 0;
+            settings.canonical_order = false;
+        }},
+        {"transpositions", []() {
+            settings.game_time = 0;
+            settings.branch_and_bound = false;
+            settings.dominance_bits = 0;
+            settings.canonical_order = false;
+        }},
+        {"score bounds", []() {
+            settings.game_time = 0;
+            settings.dominance_bits = 0;
+            settings.canonical_order = false;
+        }},
+        {"dominance", []() {
+            settings.game_time = 0;
+            settings.canonical_order = false;
+        }},
+        {"canonical order", []() {
+            settings.game_time = 0;
+        }},
+        {"deepening", []() {
+            settings.game_time = 0;
+            settings.move_budget = 60;
+        }},
+        {"game time budget", []() {
+        }},
+        {"turn planner", []() {
+            settings.game_time = 0;
+            settings.turn_planner = true;
+        }},
+    };
+
+    SearchResult base = {0, 0, 0, 0, 0, 0, 0};
+    bool same = true;
+    bool same_scores = true;
+    for (auto& pass : passes) {
+        SearchResult result = search_in_child(map, moves, pass.configure);
+        if (&pass == passes) {
+            base = result;
+        }
+        print_search(pass.name, result);
+        same = same && result.moves > 0 && result.actions == base.actions;
+        same_scores = same_scores && result.moves > 0 && result.scores == base.scores;
+    }
+    printf("same actions: %s\n", same ? "yes" : "NO");
+    printf("same scores: %s\n", same_scores ? "yes" : "NO");
+    return same && same_scores ? 0 : 1;
+}
+
+// The best score of every move, in a fresh process like search_in_child().
+vector< int > scores_in_child(const Map& map, int moves, Configure configure) {
+    vector< int > scores;
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return scores;
+    }
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        configure();
+        search_pass(map, moves, &scores);
+        bool ok = true;
+        for (size_t i = 0; ok && i < scores.size(); i += 1) {
+            ok = write(fds[1], &scores[i], sizeof scores[i]) == sizeof scores[i];
+        }
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    int score;
+    while (read(fds[0], &score, sizeof score) == sizeof score) {
+        scores.push_back(score);
+    }
+    close(fds[0]);
+    waitpid(child, NULL, 0);
+    return scores;
+}
+
+// The canonical action order must not change the best score of any move,
+// alone or together with the other cuts.
+int check_canonical(const Map& map, int moves) {
+    printf("map %s, %d moves\n", map.name.c_str(), moves);
+
+    struct {
+        const char* name;
+        Configure on;
+        Configure off;
+    } pairs[] = {
+        {"plain tree", []() {
+            settings.game_time = 0;
+            settings.transposition_bits = 0;
+            settings.branch_and_bound = false;
+            settings.dominance_bits = 0;
+        }, []() {
+            settings.game_time = 0;
+            settings.transposition_bits = 0;
+            settings.branch_and_bound = false;
+            settings.dominance_bits = 0;
+            settings.canonical_order = false;
+        }},
+        {"all cuts", []() {
+            settings.game_time = 0;
+        }, []() {
+            settings.game_time = 0;
+            settings.canonical_order = false;
+        }},
+    };
+
+    bool same = true;
+    for (auto& pair : pairs) {
+        vector< int > on = scores_in_child(map, moves, pair.on);
+        vector< int > off = scores_in_child(map, moves, pair.off);
+        int differ = 0;
+        for (size_t i = 0; i < on.size() && i < off.size(); i += 1) {
+            if (on[i] != off[i]) {
+                printf("  move %zu: %d with the order, %d without\n", i + 1, on[i], off[i]);
+                differ += 1;
+            }
+        }
+        bool ok = on.size() == (size_t) moves && off.size() == (size_t) moves && differ == 0;
+        printf("%-20s %6zu moves, %d best scores differ: %s\n",
+                pair.name, on.size(), differ, ok ? "ok" : "FAILED");
+        same = same && ok;
+    }
+    return same ? 0 : 1;
+}
+
+// Listens on address, for TCP on the first free port from 31500 up.
+TransportListener* listen_on(const string& address, int& port) {
+    for (port = 31500; port < 31600; port += 1) {
+        TransportListener* server = TransportListener::listen(address, port);
+        if (server != NULL) {
+            return server;
+        }
+    }
+    return NULL;
+}
+
+// A piece of the server's stream and how many bytes the client must have
+// written before it goes out in lockstep.
+struct Step {
+    size_t end;
+    int expect;
+};
+
+bool receive_exactly(Transport* client, int bytes) {
+    signed char buffer[64];
+    while (bytes > 0) {
+        int received = client->receive(buffer, min(bytes, (int) sizeof buffer));
+        if (received <= 0) {
+            return false;
+        }
+        bytes -= received;
+    }
+    return true;
+}
+
+// Reads until the client hangs up.
+void drain(Transport* client) {
+    signed char bytes[4096];
+    while (client->receive(bytes, sizeof bytes) > 0) {
+    }
+}
+
+// Streams everything at once, or in lockstep waits for the client's
+// answer before every step, then reads until the client hangs up.  A
+// streaming server reads the answers meanwhile: a Unix domain socket
+// charges every small write its full buffer overhead, so unread moves
+// would block the client.
+void serve(TransportListener* server, const vector< signed char >* stream,
+        const vector< Step >* steps, bool lockstep) {
+    Transport* client = server->accept();
+    if (client == NULL) {
+        return;
+    }
+    thread reader;
+    if (!lockstep) {
+        reader = thread(drain, client);
+    }
+    size_t offset = 0;
+    for (auto& step : *steps) {
+        if (lockstep && !receive_exactly(client, step.expect)) {
+            break;
+        }
+        size_t end = lockstep ? step.end : stream->size();
+        int sent;
+        while (offset < end &&
+                (sent = client->send(&(*stream)[offset], end - offset)) > 0) {
+            offset += sent;
+        }
+    }
+    if (lockstep) {
+        drain(client);
+    }
+    else {
+        reader.join();
+    }
+    delete client;
+}
+
+struct DecodeResult {
+    int contexts;
+    double first_time;      // the context with the map
+    double rest_time;       // all the others
+    long long checksum;
+};
+
+DecodeResult decode_pass(const string& address, const vector< signed char >& stream,
+        const vector< Step >& steps, bool lockstep) {
+    DecodeResult result = {0, 0, 0, 0};
+    int port;
+    unique_ptr< TransportListener > server(listen_on(address, port));
+    if (!server) {
+        cerr << "cannot listen on " << address << endl;
+        return result;
+    }
+    thread server_thread(serve, server.get(), &stream, &steps, lockstep);
+
+    RemoteProcessClient client(address, port);
+    client.writeToken("0000000000000000");
+    client.readTeamSize();
+    client.writeProtocolVersion();
+    client.readGameContext();
+
+    auto start = chrono::steady_clock::now();
+    PlayerContext* context;
+    while ((context = client.readPlayerContext()) != NULL) {
+        result.checksum += context->getWorld().getTroopers().size() + context->getTrooper().getX();
+        if (result.contexts == 0) {
+            result.first_time = seconds_since(start);
+            start = chrono::steady_clock::now();
+        }
+        result.contexts += 1;
+        Move move;
+        client.writeMove(move);
+        delete context;
+    }
+    result.rest_time = seconds_since(start);
+    client.close();
+    server_thread.join();
+    return result;
+}
+
+// Decodes contexts sent by a server thread over TCP loopback, a Unix
+// domain socket and shared memory, first streamed and then in lockstep
+// with the moves, as the runner plays.  The first context carries the map
+// and its visibilities and is timed apart.
+int bench_decode(const Map& map, int contexts) {
+    Scenario scenario(map.cells);
+    vector< Player > players = stock_players();
+    Encoder encoder;
+    vector< Step > steps;
+    encoder.team_size(5);
+    steps.push_back(Step {encoder.bytes.size(), TOKEN_MESSAGE_BYTES});
+    encoder.game(stock_game());
+    steps.push_back(Step {encoder.bytes.size(), PROTOCOL_VERSION_MESSAGE_BYTES});
+    for (int i = 0; i < contexts; i += 1) {
+        scenario.shuffle(i % 64);
+        World world(i / 5, map.cells.size(), map.cells[0].size(), players,
+                scenario.troopers, scenario.bonuses, scenario.cells, scenario.visibility);
+        encoder.player_context(scenario.troopers[i % 5], world, i == 0);
+        steps.push_back(Step {encoder.bytes.size(), i == 0 ? 0 : MOVE_MESSAGE_BYTES});
+    }
+    encoder.game_over();
+    steps.push_back(Step {encoder.bytes.size(), MOVE_MESSAGE_BYTES});
+
+    size_t first_bytes = steps[2].end - steps[1].end;
+    double rest_bytes = encoder.bytes.size() - steps[2].end;
+    printf("map %s, %d contexts, first %zu bytes, others %.0f bytes\n",
+            map.name.c_str(), contexts, first_bytes, rest_bytes);
+
+    struct Backend {
+        const char* name;
+        string address;
+    };
+    string suffix = to_string(getpid());
+    Backend backends[] = {
+        {"tcp", "127.0.0.1"},
+        {"unix", "unix:/tmp/slava-bench-" + suffix + ".sock"},
+        {"shm", "shm:/slava-bench-" + suffix},
+    };
+
+    bool ok = true;
+    long long checksum = -1;
+    for (auto& backend : backends) {
+        for (int lockstep = 0; lockstep < 2; lockstep += 1) {
+            DecodeResult result = decode_pass(backend.address, encoder.bytes, steps, lockstep);
+            printf("%-4s %-9s first %8.3f ms, others %9.3f ms %9.0f contexts/s %7.1f MB/s %7.1f us/context\n",
+                    backend.name, lockstep ? "lockstep" : "streamed",
+                    1000 * result.first_time, 1000 * result.rest_time,
+                    (result.contexts - 1) / max(result.rest_time, 1e-9),
+                    rest_bytes / max(result.rest_time, 1e-9) / 1e6,
+                    1e6 * result.rest_time / max(result.contexts - 1, 1));
+            fflush(stdout);
+            ok = ok && result.contexts == contexts && (checksum < 0 || checksum == result.checksum);
+            checksum = result.checksum;
+        }
+    }
+    return ok ? 0 : 1;
+}
+
+struct MoveTime {
+    int call;               // strategy call in the game
+    int move_index;         // game move
+    int trooper;            // TrooperType
+    double seconds;
+    long long allocations;  // during the move() call
+    bool planned;           // played from the cached plan
+};
+
+struct GameTimes {
+    string recording;
+    vector< MoveTime > moves;
+    double decode_seconds;  // reading the contexts
+    long long decode_allocations;
+    bool complete;          // ran into GAME_OVER
+};
+
+// Plays a recording through the usual decoding path and MyStrategy, as
+// Runner does, timing every move() call and counting its allocations.
+GameTimes replay_game(const string& recording) {
+    GameTimes result;
+    result.recording = recording;
+    result.decode_seconds = 0;
+    result.decode_allocations = 0;
+    result.complete = false;
+
+    ReplayTransport* transport = new ReplayTransport();
+    if (!transport->open(recording)) {
+        delete transport;
+        return result;
+    }
+    RemoteProcessClient client(transport);
+    client.setCellsHandler(MyStrategy::prepare);
+    client.writeToken("0000000000000000");
+    int team_size = client.readTeamSize();
+    client.writeProtocolVersion();
+    Game game = client.readGameContext();
+
+    vector< unique_ptr< MyStrategy > > strategies;
+    for (int i = 0; i < team_size; i += 1) {
+        strategies.push_back(unique_ptr< MyStrategy >(new MyStrategy()));
+    }
+
+    result.moves.reserve(1 << 12);
+    while (true) {
+        auto start = chrono::steady_clock::now();
+        long long allocated = allocations;
+        PlayerContext* context = client.readPlayerContext();
+        result.decode_seconds += seconds_since(start);
+        result.decode_allocations += allocations - allocated;
+        if (context == NULL) {
+            break;
+        }
+
+        const Trooper& self = context->getTrooper();
+        Move move;
+        start = chrono::steady_clock::now();
+        allocated = allocations;
+        long long plan_hits = telemetry.plan_hits;
+        strategies[self.getTeammateIndex()]->move(self, context->getWorld(), game, move);
+        MoveTime time = {(int) result.moves.size(), context->getWorld().getMoveIndex(),
+            self.getType(), seconds_since(start), allocations - allocated,
+            telemetry.plan_hits > plan_hits};
+        result.moves.push_back(time);
+
+        client.writeMove(move);
+        delete context;
+    }
+    result.complete = true;
+    return result;
+}
+
+// Strategy state is global, so every game is replayed in a fresh process.
+GameTimes replay_in_child(const string& recording) {
+    GameTimes result;
+    result.recording = recording;
+    result.decode_seconds = 0;
+    result.decode_allocations = 0;
+    result.complete = false;
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return result;
+    }
+    pid_t child = fork();
+    if (child == 0) {
+        close(fds[0]);
+        GameTimes times = replay_game(recording);
+        bool ok = write(fds[1], &times.decode_seconds, sizeof times.decode_seconds) > 0 &&
+            write(fds[1], &times.decode_allocations, sizeof times.decode_allocations) > 0 &&
+            write(fds[1], &times.complete, sizeof times.complete) > 0;
+        for (size_t i = 0; ok && i < times.moves.size(); i += 1) {
+            ok = write(fds[1], &times.moves[i], sizeof times.moves[i]) == sizeof times.moves[i];
+        }
+        _exit(ok ? 0 : 1);
+    }
+    close(fds[1]);
+    FILE* in = fdopen(fds[0], "rb");
+    if (fread(&result.decode_seconds, sizeof result.decode_seconds, 1, in) == 1 &&
+            fread(&result.decode_allocations, sizeof result.decode_allocations, 1, in) == 1 &&
+            fread(&result.complete, sizeof result.complete, 1, in) == 1) {
+        MoveTime time;
+        while (fread(&time, sizeof time, 1, in) == 1) {
+            result.moves.push_back(time);
+        }
+    }
+    fclose(in);
+    int status = 0;
+    waitpid(child, &status, 0);
+    result.complete = result.complete && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return result;
+}
+
+int bench_replay(const vector< string >& recordings, int worst_count) {
+    vector< GameTimes > games;
+    vector< double > all;
+    bool ok = true;
+
+    printf("%-40s %6s %12s %12s %12s %12s %12s %8s\n", "recording", "moves", "move, ms",
+            "decode, ms", "max, ms", "allocs/move", "allocs/ctx", "planned");
+    for (auto& recording : recordings) {
+        GameTimes game = replay_in_child(recording);
+        double total = 0;
+        double worst = 0;
+        long long allocated = 0;
+        int planned = 0;
+        for (auto& move : game.moves) {
+            total += move.seconds;
+            planned += move.planned;
+            worst = max(worst, move.seconds);
+            allocated += move.allocations;
+            all.push_back(move.seconds);
+        }
+        // The first move builds the distances and is left out of the count.
+        size_t counted = max(game.moves.size(), (size_t) 2) - 1;
+        if (!game.moves.empty()) {
+            allocated -= game.moves[0].allocations;
+        }
+        printf("%-40s %6zu %12.3f %12.3f %12.3f %12.1f %12.1f %7.1f%%%s\n", recording.c_str(),
+                game.moves.size(), 1000 * total, 1000 * game.decode_seconds, 1000 * worst,
+                (double) allocated / counted,
+                (double) game.decode_allocations / max(game.moves.size(), (size_t) 1),
+                100.0 * planned / max(game.moves.size(), (size_t) 1),
+                game.complete ? "" : "  (incomplete)");
+        ok = ok && game.complete;
+        games.push_back(game);
+    }
+
+    sort(all.begin(), all.end());
+    printf("\n%zu moves, ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", all.size(),
+            1000 * percentile(all, 0.5), 1000 * percentile(all, 0.9),
+            1000 * percentile(all, 0.99), 1000 * percentile(all, 1));
+
+    vector< pair< double, pair< int, int > > > worst;    // seconds, (game, move)
+    for (size_t g = 0; g < games.size(); g += 1) {
+        for (size_t m = 0; m < games[g].moves.size(); m += 1) {
+            worst.push_back(make_pair(games[g].moves[m].seconds, make_pair(g, m)));
+        }
+    }
+    sort(worst.rbegin(), worst.rend());
+    worst.resize(min(worst.size(), (size_t) worst_count));
+
+    const char* troopers[] = {"COMMANDER", "FIELD_MEDIC", "SOLDIER", "SNIPER", "SCOUT"};
+    printf("\nworst moves:\n");
+    for (auto& w : worst) {
+        const MoveTime& move = games[w.second.first].moves[w.second.second];
+        printf("%10.3f ms  %s call %d, move %d, %s\n", 1000 * move.seconds,
+                games[w.second.first].recording.c_str(), move.call, move.move_index,
+                0 <= move.trooper && move.trooper < 5 ? troopers[move.trooper] : "UNKNOWN");
+    }
+    return ok ? 0 : 1;
+}
+
+void usage() {
+    cerr << "usage: Benchmark distances [map files...]" << endl
+         << "       Benchmark search [moves] [map name or file]" << endl
+         << "       Benchmark canonical [moves] [map name or file]" << endl
+         << "       Benchmark decode [contexts]" << endl
+         << "       Benchmark replay recordings..." << endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+
+    string mode = argv[1];
+    if (mode == "distances") {
+        vector< Map > maps;
+        for (int i = 2; i < argc; i += 1) {
+            Map map;
+            if (!load_map(argv[i], map)) {
+                cerr << "cannot read map " << argv[i] << endl;
+                return 2;
+            }
+            maps.push_back(map);
+        }
+        if (maps.empty()) {
+            maps = default_maps();
+        }
+        return bench_distances(maps);
+    }
+
+    if (mode == "decode") {
+        int contexts = argc > 2 ? atoi(argv[2]) : 5000;
+        return bench_decode(default_maps()[2], max(contexts, 1));
+    }
+
+    // The strategy logs every move under SLAVA_DEBUG.
+    cerr.setstate(ios_base::failbit);
+
+    if (mode == "replay") {
+        vector< string > recordings(argv + 2, argv + argc);
+        if (recordings.empty()) {
+            usage();
+            return 2;
+        }
+        return bench_replay(recordings, 10);
+    }
+
+    if (mode == "search" || mode == "canonical") {
+        int moves = argc > 2 ? atoi(argv[2]) : 80;
+        Map map = default_maps()[2];
+        if (argc > 3 && !find_map(argv[3], map)) {
+            cerr.clear();
+            cerr << "cannot read map " << argv[3] << endl;
+            return 2;
+        }
+        return mode == "search" ? bench_search(map, moves) : check_canonical(map, moves);
+    }
+
+    usage();
+    return 2;
+}
@@ -0,0 +1,162 @@
+#include "Encoder.h"
+
+#include <cstring>
+
+#include "../RemoteProcessClient.h"
+
+using namespace model;
+using namespace std;
+
+typedef vector< vector< CellType > > Cells;
+
+void Encoder::team_size(int size) {
+    put_enum(TEAM_SIZE);
+    put_int(size);
+}
+
+void Encoder::game(const Game& g) {
+    put_enum(GAME_CONTEXT);
+    put_bool(true);
+    put_int(g.getMoveCount());
+    put_int(g.getLastPlayerEliminationScore());
+    put_int(g.getPlayerEliminationScore());
+    put_int(g.getTrooperEliminationScore());
+    put_double(g.getTrooperDamageScoreFactor());
+    put_int(g.getStanceChangeCost());
+    put_int(g.getStandingMoveCost());
+    put_int(g.getKneelingMoveCost());
+    put_int(g.getProneMoveCost());
+    put_int(g.getCommanderAuraBonusActionPoints());
+    put_double(g.getCommanderAuraRange());
+    put_int(g.getCommanderRequestEnemyDispositionCost());
+    put_int(g.getCommanderRequestEnemyDispositionMaxOffset());
+    put_int(g.getFieldMedicHealCost());
+    put_int(g.getFieldMedicHealBonusHitpoints());
+    put_int(g.getFieldMedicHealSelfBonusHitpoints());
+    put_double(g.getSniperStandingStealthBonus());
+    put_double(g.getSniperKneelingStealthBonus());
+    put_double(g.getSniperProneStealthBonus());
+    put_double(g.getSniperStandingShootingRangeBonus());
+    put_double(g.getSniperKneelingShootingRangeBonus());
+    put_double(g.getSniperProneShootingRangeBonus());
+    put_double(g.getScoutStealthBonusNegation());
+    put_int(g.getGrenadeThrowCost());
+    put_double(g.getGrenadeThrowRange());
+    put_int(g.getGrenadeDirectDamage());
+    put_int(g.getGrenadeCollateralDamage());
+    put_int(g.getMedikitUseCost());
+    put_int(g.getMedikitBonusHitpoints());
+    put_int(g.getMedikitHealSelfBonusHitpoints());
+    put_int(g.getFieldRationEatCost());
+    put_int(g.getFieldRationBonusActionPoints());
+}
+
+void Encoder::trooper(const Trooper& t) {
+    put_bool(true);
+    put_long(t.getId());
+    put_int(t.getX());
+    put_int(t.getY());
+    put_long(t.getPlayerId());
+    put_int(t.getTeammateIndex());
+    put_bool(t.isTeammate());
+    put_enum(t.getType());
+    put_enum(t.getStance());
+    put_int(t.getHitpoints());
+    put_int(t.getMaximalHitpoints());
+    put_int(t.getActionPoints());
+    put_int(t.getInitialActionPoints());
+    put_double(t.getVisionRange());
+    put_double(t.getShootingRange());
+    put_int(t.getShootCost());
+    put_int(t.getStandingDamage());
+    put_int(t.getKneelingDamage());
+    put_int(t.getProneDamage());
+    put_int(t.getDamage());
+    put_bool(t.isHoldingGrenade());
+    put_bool(t.isHoldingMedikit());
+    put_bool(t.isHoldingFieldRation());
+}
+
+void Encoder::player_context(const Trooper& self, const World& world, bool first) {
+    put_enum(PLAYER_CONTEXT);
+    put_bool(true);
+    trooper(self);
+
+    put_bool(true);
+    put_int(world.getMoveIndex());
+    put_int(world.getWidth());
+    put_int(world.getHeight());
+
+    put_int(world.getPlayers().size());
+    for (auto& player : world.getPlayers()) {
+        put_bool(true);
+        put_long(player.getId());
+        put_string(player.getName());
+        put_int(player.getScore());
+        put_bool(player.isStrategyCrashed());
+        put_int(player.getApproximateX());
+        put_int(player.getApproximateY());
+    }
+
+    put_int(world.getTroopers().size());
+    for (auto& t : world.getTroopers()) {
+        trooper(t);
+    }
+
+    put_int(world.getBonuses().size());
+    for (auto& bonus : world.getBonuses()) {
+        put_bool(true);
+        put_long(bonus.getId());
+        put_int(bonus.getX());
+        put_int(bonus.getY());
+        put_enum(bonus.getType());
+    }
+
+    if (!first) {
+        return;
+    }
+
+    const Cells& cells = world.getCells();
+    put_int(cells.size());
+    for (auto& column : cells) {
+        put_int(column.size());
+        for (auto& cell : column) {
+            put_enum(cell);
+        }
+    }
+
+    int width = world.getWidth();
+    int height = world.getHeight();
+    put_int(width);
+    put_int(height);
+    put_int(_TROOPER_STANCE_COUNT_);
+    for (int vx = 0; vx < width; vx += 1) {
+        for (int vy = 0; vy < height; vy += 1) {
+            for (int ox = 0; ox < width; ox += 1) {
+                for (int oy = 0; oy < height; oy += 1) {
+                    for (int stance = 0; stance < _TROOPER_STANCE_COUNT_; stance += 1) {
+                        put_bool(world.getCellVisibilities().isVisible(vx, vy, ox, oy, stance));
+                    }
+                }
+            }
+        }
+    }
+}
+
+void Encoder::game_over() {
+    put_enum(GAME_OVER);
+}
+
+bool decode_move(const signed char* bytes, Move& move) {
+    if (bytes[0] != MOVE_MESSAGE || bytes[1] == 0) {
+        return false;
+    }
+    int x, y;
+    memcpy(&x, bytes + 4, 4);
+    memcpy(&y, bytes + 8, 4);
+    move.setAction((ActionType) bytes[2]);
+    move.setDirection((Direction) bytes[3]);
+    move.setX(x);
+    move.setY(y);
+    return true;
+}
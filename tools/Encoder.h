@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef _ENCODER_H_
+#define _ENCODER_H_
+
+#include <string>
+#include <vector>
+
+#include "../model/Game.h"
+#include "../model/Move.h"
+#include "../model/Trooper.h"
+#include "../model/World.h"
+
+// The server side of the protocol, little-endian like the runner.
+struct Encoder {
+    std::vector< signed char > bytes;
+
+    void put(const void* data, size_t size) {
+        const signed char* p = (const signed char*) data;
+        bytes.insert(bytes.end(), p, p + size);
+    }
+
+    void put_enum(int value)       { signed char b = value; put(&b, 1); }
+    void put_bool(bool value)      { put_enum(value ? 1 : 0); }
+    void put_int(int value)        { put(&value, sizeof value); }
+    void put_long(long long value) { put(&value, sizeof value); }
+    void put_double(double value)  { put(&value, sizeof value); }
+
+    void put_string(const std::string& value) {
+        put_int(value.size());
+        put(value.data(), value.size());
+    }
+
+    void team_size(int size);
+    void game(const model::Game& g);
+    void trooper(const model::Trooper& t);
+    // Cells and visibilities go with the first context only.
+    void player_context(const model::Trooper& self, const model::World& world, bool first);
+    void game_over();
+};
+
+// What a client sends: sizes of its fixed messages and a move decoder.
+const int TOKEN_MESSAGE_BYTES = 1 + 4 + 16;
+const int PROTOCOL_VERSION_MESSAGE_BYTES = 1 + 4;
+const int MOVE_MESSAGE_BYTES = 1 + 1 + 1 + 1 + 4 + 4;
+
+// False unless bytes hold a MOVE_MESSAGE.
+bool decode_move(const signed char* bytes, model::Move& move);
+
+#endif
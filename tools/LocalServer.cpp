@@ -0,0 +1,238 @@
+#include "Encoder.h"
+#include "Measure.h"
+#include "Scenario.h"
+
+#include "../RemoteProcessClient.h"
+#include "../Transport.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace model;
+using namespace std;
+
+// A stand-in for local-runner.jar: speaks the runner protocol to one
+// strategy at a time, with scripted contexts or a recorded game.
+
+struct Options {
+    string address;         // host, "unix:<path>" or "shm:<name>"
+    int port;
+    int games;
+    int contexts;           // scripted contexts per game
+    int team_size;
+    string map;             // default map name or map file
+    string recording;       // play this instead of scripted contexts
+};
+
+bool receive_bytes(Transport* client, signed char* bytes, int count) {
+    while (count > 0) {
+        int received = client->receive(bytes, count);
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        count -= received;
+    }
+    return true;
+}
+
+bool send_bytes(Transport* client, const vector< signed char >& bytes) {
+    size_t offset = 0;
+    int sent;
+    while (offset < bytes.size() &&
+            (sent = client->send(&bytes[offset], bytes.size() - offset)) > 0) {
+        offset += sent;
+    }
+    return offset == bytes.size();
+}
+
+bool send_message(Transport* client, Encoder& encoder) {
+    bool sent = send_bytes(client, encoder.bytes);
+    encoder.bytes.clear();
+    return sent;
+}
+
+void report(int game, const char* source, vector< double > round_trips, double seconds) {
+    sort(round_trips.begin(), round_trips.end());
+    printf("game %d (%s): %zu moves in %.3f s, round trip ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n",
+            game, source, round_trips.size(), seconds,
+            1000 * percentile(round_trips, 0.5), 1000 * percentile(round_trips, 0.9),
+            1000 * percentile(round_trips, 0.99), 1000 * percentile(round_trips, 1));
+    fflush(stdout);
+}
+
+// Token, team size, protocol version and game context, then the scripted
+// contexts, each answered by a move, and GAME_OVER.
+bool play_scripted(Transport* client, const Options& options, const Map& map,
+        const Scenario& base, vector< double >& round_trips) {
+    Scenario scenario = base;
+    signed char header[5];
+    int token_length;
+    if (!receive_bytes(client, header, 5) || header[0] != AUTHENTICATION_TOKEN) {
+        fprintf(stderr, "expected a token\n");
+        return false;
+    }
+    memcpy(&token_length, header + 1, 4);
+    vector< signed char > token(max(token_length, 0));
+    if (!receive_bytes(client, token.data(), token.size())) {
+        return false;
+    }
+
+    Encoder encoder;
+    encoder.team_size(options.team_size);
+    send_message(client, encoder);
+
+    signed char version[PROTOCOL_VERSION_MESSAGE_BYTES];
+    int protocol;
+    if (!receive_bytes(client, version, sizeof version) || version[0] != PROTOCOL_VERSION) {
+        fprintf(stderr, "expected a protocol version\n");
+        return false;
+    }
+    memcpy(&protocol, version + 1, 4);
+    if (protocol != 2) {
+        fprintf(stderr, "protocol version %d, serving version 2 anyway\n", protocol);
+    }
+
+    encoder.game(stock_game());
+    send_message(client, encoder);
+
+    vector< Player > players = stock_players();
+    for (int i = 0; i < options.contexts; i += 1) {
+        scenario.shuffle(i % 64);
+        World world(i / options.team_size, map.cells.size(), map.cells[0].size(), players,
+                scenario.troopers, scenario.bonuses, scenario.cells, scenario.visibility);
+        encoder.player_context(scenario.troopers[i % options.team_size], world, i == 0);
+
+        auto start = chrono::steady_clock::now();
+        signed char answer[MOVE_MESSAGE_BYTES];
+        Move move;
+        if (!send_message(client, encoder) ||
+                !receive_bytes(client, answer, sizeof answer) || !decode_move(answer, move)) {
+            fprintf(stderr, "no move for context %d\n", i);
+            return false;
+        }
+        round_trips.push_back(seconds_since(start));
+    }
+
+    encoder.game_over();
+    return send_message(client, encoder);
+}
+
+// The server's side of a recording in lockstep: received frames are sent,
+// and every sent frame is waited for, whatever bytes the strategy answers.
+bool play_recording(Transport* client, const string& recording,
+        vector< double >& round_trips) {
+    RecordingReader reader;
+    if (!reader.open(recording)) {
+        fprintf(stderr, "cannot read recording %s\n", recording.c_str());
+        return false;
+    }
+
+    RecordingFrame frame;
+    string bytes;
+    vector< signed char > buffer;
+    bool sent = false;
+    auto start = chrono::steady_clock::now();
+    while (reader.next(frame, bytes)) {
+        buffer.assign(bytes.begin(), bytes.end());
+        if (frame.direction == 'R') {
+            if (!send_bytes(client, buffer)) {
+                return false;
+            }
+            start = chrono::steady_clock::now();
+            sent = true;
+        }
+        else {
+            if (!receive_bytes(client, buffer.data(), buffer.size())) {
+                fprintf(stderr, "strategy hung up\n");
+                return false;
+            }
+            if (sent && buffer.size() == MOVE_MESSAGE_BYTES) {
+                round_trips.push_back(seconds_since(start));
+            }
+            sent = false;
+        }
+    }
+    return true;
+}
+
+void usage() {
+    fprintf(stderr,
+            "usage: LocalServer [-a address] [-p port] [-g games] [-n contexts]\n"
+            "                   [-t team size] [-m map name or file] [-r recording]\n"
+            "address is a host (127.0.0.1 by default), unix:<path> or shm:<name>\n");
+}
+
+int main(int argc, char* argv[]) {
+    Options options = {"127.0.0.1", 31001, 1, 100, 5, "cover-20", ""};
+    int option;
+    while ((option = getopt(argc, argv, "a:p:g:n:t:m:r:")) != -1) {
+        switch (option) {
+            case 'a': options.address = optarg; break;
+            case 'p': options.port = atoi(optarg); break;
+            case 'g': options.games = atoi(optarg); break;
+            case 'n': options.contexts = atoi(optarg); break;
+            case 't': options.team_size = atoi(optarg); break;
+            case 'm': options.map = optarg; break;
+            case 'r': options.recording = optarg; break;
+            default: usage(); return 2;
+        }
+    }
+    if (optind != argc || options.team_size < 1 || options.team_size > 5) {
+        usage();
+        return 2;
+    }
+
+    Map map = default_maps()[0];
+    if (options.recording.empty() && !find_map(options.map, map)) {
+        fprintf(stderr, "cannot read map %s\n", options.map.c_str());
+        return 2;
+    }
+    if (options.recording.empty()) {
+        printf("map %s\n", map.name.c_str());
+    }
+    Scenario scenario(map.cells);
+
+    TransportListener* server = TransportListener::listen(options.address, options.port);
+    if (server == NULL) {
+        fprintf(stderr, "cannot listen on %s port %d\n", options.address.c_str(), options.port);
+        return 2;
+    }
+    printf("listening on %s port %d\n", options.address.c_str(), options.port);
+    fflush(stdout);
+
+    bool ok = true;
+    for (int game = 1; game <= options.games; game += 1) {
+        Transport* client = server->accept();
+        if (client == NULL) {
+            ok = false;
+            break;
+        }
+
+        vector< double > round_trips;
+        auto start = chrono::steady_clock::now();
+        bool played = options.recording.empty()
+            ? play_scripted(client, options, map, scenario, round_trips)
+            : play_recording(client, options.recording, round_trips);
+        double seconds = seconds_since(start);
+
+        // Drains the connection until the strategy hangs up.
+        signed char drain[4096];
+        while (client->receive(drain, sizeof drain) > 0) {
+        }
+        delete client;
+
+        report(game, options.recording.empty() ? map.name.c_str() : options.recording.c_str(),
+                round_trips, seconds);
+        ok = ok && played;
+    }
+    delete server;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+#include "Measure.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+double seconds_since(const chrono::steady_clock::time_point& start) {
+    return chrono::duration< double >(chrono::steady_clock::now() - start).count();
+}
+
+double percentile(const vector< double >& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = (size_t) ceil(p * sorted.size());
+    return sorted[min(max(index, (size_t) 1), sorted.size()) - 1];
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#ifndef _MEASURE_H_
+#define _MEASURE_H_
+
+#include <chrono>
+#include <vector>
+
+// Timing helpers the local tools share.
+
+double seconds_since(const std::chrono::steady_clock::time_point& start);
+
+// The value at fraction p of sorted values, 0 when there are none.
+double percentile(const std::vector< double >& sorted, double p);
+
+#endif
@@ -0,0 +1,188 @@
+#include "Scenario.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+
+using namespace model;
+using namespace std;
+
+typedef vector< vector< CellType > > Cells;
+
+bool load_map(const string& path, Map& map) {
+    ifstream in(path.c_str());
+    vector< string > rows;
+    string row;
+    while (getline(in, row)) {
+        if (!row.empty()) {
+            rows.push_back(row);
+        }
+    }
+    if (rows.empty()) {
+        return false;
+    }
+
+    map.name = path;
+    map.cells.assign(rows[0].size(), vector< CellType >(rows.size(), FREE));
+    for (size_t y = 0; y < rows.size(); y += 1) {
+        for (size_t x = 0; x < rows[y].size() && x < map.cells.size(); x += 1) {
+            char c = rows[y][x];
+            map.cells[x][y] = '1' <= c && c <= '3' ? (CellType) (c - '0') : FREE;
+        }
+    }
+    return true;
+}
+
+Map random_map(const string& name, int size_x, int size_y, int cover_percent, int seed) {
+    srand(seed);
+    Map map;
+    map.name = name;
+    map.cells.assign(size_x, vector< CellType >(size_y, FREE));
+    for (int x = 0; x < size_x; x += 1) {
+        for (int y = 0; y < size_y; y += 1) {
+            if (rand() % 100 < cover_percent) {
+                map.cells[x][y] = (CellType) (LOW_COVER + rand() % 3);
+            }
+        }
+    }
+    return map;
+}
+
+vector< Map > default_maps() {
+    vector< Map > maps;
+    maps.push_back(random_map("empty",    30, 20, 0,  1));
+    maps.push_back(random_map("cover-10", 30, 20, 10, 2));
+    maps.push_back(random_map("cover-20", 30, 20, 20, 3));
+    maps.push_back(random_map("cover-30", 30, 20, 30, 4));
+    return maps;
+}
+
+bool find_map(const string& name, Map& map) {
+    for (auto& m : default_maps()) {
+        if (m.name == name) {
+            map = m;
+            return true;
+        }
+    }
+    return load_map(name, map);
+}
+
+Game stock_game() {
+    return Game(50, 0, 0, 0, 1.0,
+            2, 2, 4, 6,
+            2, 5.0,
+            10, 3,
+            1, 50, 30,
+            0.5, 1.0, 1.5, 0.0, 1.0, 2.0, 1.0,
+            8, 5.0, 80, 60,
+            2, 50, 30,
+            2, 5);
+}
+
+namespace {
+    bool line_of_sight(const Cells& cells, int vx, int vy, int ox, int oy, int stance) {
+        int steps = 2 * max(abs(ox - vx), abs(oy - vy));
+        for (int i = 1; i < steps; i += 1) {
+            int x = (int) floor(vx + (ox - vx) * (double) i / steps + 0.5);
+            int y = (int) floor(vy + (oy - vy) * (double) i / steps + 0.5);
+            if ((x != vx || y != vy) && (x != ox || y != oy) &&
+                    cells[x][y] != FREE && cells[x][y] > stance) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+VisibilityMatrix compute_visibility(const Cells& cells) {
+    int size_x = cells.size();
+    int size_y = cells[0].size();
+    VisibilityMatrix visibility(size_x, size_y, _TROOPER_STANCE_COUNT_);
+    for (int vx = 0; vx < size_x; vx += 1) {
+        for (int vy = 0; vy < size_y; vy += 1) {
+            for (int ox = 0; ox < size_x; ox += 1) {
+                for (int oy = 0; oy < size_y; oy += 1) {
+                    for (int stance = 0; stance < _TROOPER_STANCE_COUNT_; stance += 1) {
+                        if (line_of_sight(cells, vx, vy, ox, oy, stance)) {
+                            visibility.set(vx, vy, ox, oy, stance);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return visibility;
+}
+
+Trooper make_trooper(long long id, int x, int y, long long player, int index,
+        TrooperType type, TrooperStance stance, int hitpoints,
+        bool grenade, bool medikit, bool field_ration) {
+    // hitpoints, action points, shoot cost, damage standing/kneeling/prone, vision, range
+    const int stats[5][8] = {
+        {100, 10, 3, 15, 20, 25, 8, 7},
+        {100, 10, 2,  9, 12, 15, 7, 5},
+        {120, 10, 4, 25, 30, 35, 7, 8},
+        {100, 10, 9, 65, 80, 95, 7, 10},
+        {100, 12, 4, 20, 25, 30, 9, 6},
+    };
+    const int* s = stats[type];
+    int damage = stance == STANDING ? s[3] : (stance == KNEELING ? s[4] : s[5]);
+    return Trooper(id, x, y, player, index, player == 1, type, stance,
+            min(hitpoints, s[0]), s[0], s[1], s[1], s[6], s[7], s[2],
+            s[3], s[4], s[5], damage, grenade, medikit, field_ration);
+}
+
+vector< Player > stock_players() {
+    vector< Player > players;
+    players.push_back(Player(1, "Slava", 0, false, -1, -1));
+    players.push_back(Player(2, "Smart2", 0, false, -1, -1));
+    players.push_back(Player(3, "Smart3", 0, false, -1, -1));
+    players.push_back(Player(4, "Smart4", 0, false, -1, -1));
+    return players;
+}
+
+Scenario::Scenario(const Cells& cells): cells(cells), visibility(compute_visibility(cells)) {}
+
+void Scenario::shuffle(int seed) {
+    srand(seed);
+    vector< pair< int, int > > free;
+    for (size_t x = 0; x < cells.size(); x += 1) {
+        for (size_t y = 0; y < cells[x].size(); y += 1) {
+            if (cells[x][y] == FREE) {
+                free.push_back(make_pair(x, y));
+            }
+        }
+    }
+    for (size_t i = free.size(); i > 1; i -= 1) {
+        swap(free[i - 1], free[rand() % i]);
+    }
+
+    troopers.clear();
+    bonuses.clear();
+    size_t next = 0;
+    long long id = 1;
+    for (int index = 0; index < 5 && next < free.size(); index += 1) {
+        troopers.push_back(make_trooper(id++, free[next].first, free[next].second,
+                    1, index, (TrooperType) index, (TrooperStance) (rand() % 3),
+                    20 + rand() % 100, rand() % 3 == 0, rand() % 3 == 0, false));
+        next += 1;
+    }
+    int enemies = 2 + rand() % 5;
+    for (int index = 0; index < enemies && next < free.size(); index += 1) {
+        troopers.push_back(make_trooper(id++, free[next].first, free[next].second,
+                    2 + index % 3, index, (TrooperType) (rand() % 5),
+                    (TrooperStance) (rand() % 3), 20 + rand() % 100, false, false, false));
+        next += 1;
+    }
+    for (int index = 0; index < 6 && next < free.size(); index += 1) {
+        bonuses.push_back(Bonus(100 + index, free[next].first, free[next].second,
+                    (BonusType) (rand() % 3)));
+        next += 1;
+    }
+}
+
+World Scenario::world(int move_index) const {
+    return World(move_index, cells.size(), cells[0].size(), vector< Player >(),
+            troopers, bonuses, cells, visibility);
+}
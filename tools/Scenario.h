@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef _SCENARIO_H_
+#define _SCENARIO_H_
+
+#include <string>
+#include <vector>
+
+#include "../model/Game.h"
+#include "../model/Player.h"
+#include "../model/World.h"
+
+// Maps, game settings and positions the benchmark and the local server
+// play on when there is no runner.
+
+struct Map {
+    std::string name;
+    std::vector< std::vector< model::CellType > > cells;
+};
+
+// One text row per y, one character per x: '.' free, '1'-'3' cover.
+bool load_map(const std::string& path, Map& map);
+
+Map random_map(const std::string& name, int size_x, int size_y, int cover_percent, int seed);
+
+// The stock maps ship inside local-runner.jar, so without map files the
+// benchmark uses stand-ins of the stock 30x20 size.
+std::vector< Map > default_maps();
+
+// A default map by name, else a map file.
+bool find_map(const std::string& name, Map& map);
+
+model::Game stock_game();
+
+std::vector< model::Player > stock_players();
+
+// A straight line from viewer to object, sampled twice per cell, must not
+// cross cover higher than the stance.
+model::VisibilityMatrix compute_visibility(const std::vector< std::vector< model::CellType > >& cells);
+
+model::Trooper make_trooper(long long id, int x, int y, long long player, int index,
+        model::TrooperType type, model::TrooperStance stance, int hitpoints,
+        bool grenade, bool medikit, bool field_ration);
+
+// Our full squad and a few enemies on random free cells, plus bonuses.
+struct Scenario {
+    std::vector< std::vector< model::CellType > > cells;
+    model::VisibilityMatrix visibility;
+    std::vector< model::Trooper > troopers;
+    std::vector< model::Bonus > bonuses;
+
+    Scenario(const std::vector< std::vector< model::CellType > >& cells);
+
+    void shuffle(int seed);
+
+    model::World world(int move_index) const;
+};
+
+#endif